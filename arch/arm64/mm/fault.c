@@ -556,6 +556,7 @@ static int __kprobes do_page_fault(unsigned long far, unsigned long esr,
 	unsigned int mm_flags = FAULT_FLAG_DEFAULT;
 	unsigned long addr = untagged_addr(far);
 	struct vm_area_struct *vma;
+	bool vma_retried = false;
 
 	if (kprobe_page_fault(regs, esr))
 		return 0;
@@ -616,12 +617,14 @@ static int __kprobes do_page_fault(unsigned long far, unsigned long esr,
 	if (!(mm_flags & FAULT_FLAG_USER))
 		goto lock_mmap;
 
+retry_vma:
 	vma = lock_vma_under_rcu(mm, addr);
 	if (!vma)
 		goto lock_mmap;
 
 	if (!(vma->vm_flags & vm_flags)) {
 		vma_end_read(vma);
+		count_vma_lock_fallback(mm, ACCESS);
 		goto lock_mmap;
 	}
 	fault = handle_mm_fault(vma, addr, mm_flags | FAULT_FLAG_VMA_LOCK, regs);
@@ -642,6 +645,18 @@ static int __kprobes do_page_fault(unsigned long far, unsigned long esr,
 			goto no_context;
 		return 0;
 	}
+
+	/*
+	 * The VMA lock was only dropped to wait for I/O. The data is most
+	 * likely in memory now, so retry once under the VMA lock instead of
+	 * contending on mmap_lock. FAULT_FLAG_TRIED keeps the second attempt
+	 * from dropping the lock again.
+	 */
+	if ((fault & VM_FAULT_MAJOR) && !vma_retried) {
+		vma_retried = true;
+		count_vm_vma_lock_event(VMA_LOCK_IO_RETRY);
+		goto retry_vma;
+	}
 lock_mmap:
 
 retry:
@@ -30,6 +30,7 @@
 #include "qcom-lpm.h"
 
 static DEFINE_PER_CPU(ktime_t, cpu_next_wakeup);
+static DEFINE_PER_CPU(ktime_t, cpu_next_event);
 LIST_HEAD(cluster_dev_list);
 
 static struct lpm_cluster *to_cluster(struct generic_pm_domain *genpd)
@@ -43,6 +44,26 @@ static struct lpm_cluster *to_cluster(struct generic_pm_domain *genpd)
 	return NULL;
 }
 
+/**
+ * get_cluster_next_event() - It returns the earliest timer event of all cpus
+ *			    which are online for this cluster domain,
+ *			    regardless of their predicted wakeups.
+ * @cluster_gov: Targeted cluster's lpm data structure
+ */
+static ktime_t get_cluster_next_event(struct lpm_cluster *cluster_gov)
+{
+	int cpu;
+	ktime_t next_event = KTIME_MAX, next_cpu_event;
+
+	for_each_cpu_and(cpu, cluster_gov->genpd->cpus, cpu_online_mask) {
+		next_cpu_event = READ_ONCE(per_cpu(cpu_next_event, cpu));
+		if (ktime_before(next_cpu_event, next_event))
+			next_event = next_cpu_event;
+	}
+
+	return next_event;
+}
+
 /**
  * clusttimer_fn() - Will be executed when cluster prediction timer expires
  * @h:      Cluster prediction timer
@@ -59,6 +80,7 @@ static enum hrtimer_restart clusttimer_fn(struct hrtimer *h)
 	cluster_gov->pred_residency = 0;
 	cluster_gov->is_timer_expired = true;
 	cluster_gov->is_timer_queued = false;
+	cluster_gov->next_event.timer_wakeups++;
 
 	return HRTIMER_NORESTART;
 }
@@ -280,6 +302,7 @@ static int cluster_power_down(struct lpm_cluster *cluster_gov)
 	struct genpd_governor_data *gd = genpd->gd;
 	int idx = genpd->state_idx;
 	uint32_t residency;
+	u64 timer_ns;
 	s64 cpus_qos;
 	int i;
 
@@ -344,7 +367,19 @@ static int cluster_power_down(struct lpm_cluster *cluster_gov)
 	else
 		residency = genpd->states[idx].residency_ns;
 
-	clusttimer_start(cluster_gov, residency + PRED_TIMER_ADD * NSEC_PER_USEC);
+	/*
+	 * No need to correct the prediction when a cpu of the cluster
+	 * has a timer that wakes the cluster before the correction would.
+	 */
+	timer_ns = residency + PRED_TIMER_ADD * NSEC_PER_USEC;
+	if (ktime_before(get_cluster_next_event(cluster_gov),
+			 ktime_add_ns(cluster_gov->now, timer_ns))) {
+		cluster_gov->next_event.timers_avoided++;
+		return 0;
+	}
+
+	clusttimer_start(cluster_gov, timer_ns);
+	cluster_gov->next_event.timers_started++;
 	cluster_gov->is_timer_expired = false;
 
 	return 0;
@@ -433,7 +468,7 @@ ktime_t get_cluster_sleep_time(struct lpm_cluster *cluster_gov)
 
 	next_wakeup = KTIME_MAX;
 	for_each_cpu_and(cpu, genpd->cpus, cpu_online_mask) {
-		next_cpu_wakeup = per_cpu(cpu_next_wakeup, cpu);
+		next_cpu_wakeup = READ_ONCE(per_cpu(cpu_next_wakeup, cpu));
 		if (ktime_before(next_cpu_wakeup, next_wakeup))
 			next_wakeup = next_cpu_wakeup;
 	}
@@ -450,12 +485,13 @@ ktime_t get_cluster_sleep_time(struct lpm_cluster *cluster_gov)
  */
 static void update_cluster_next_wakeup(struct lpm_cluster *cluster_gov)
 {
-	cluster_gov->next_wakeup = get_cluster_sleep_time(cluster_gov);
+	ktime_t next_wakeup = get_cluster_sleep_time(cluster_gov);
 
-	if (ktime_before(cluster_gov->next_wakeup, ktime_get()))
-		cluster_gov->next_wakeup = KTIME_MAX;
+	if (ktime_before(next_wakeup, ktime_get()))
+		next_wakeup = KTIME_MAX;
 
-	dev_pm_genpd_set_next_wakeup(cluster_gov->dev, cluster_gov->next_wakeup);
+	WRITE_ONCE(cluster_gov->next_wakeup, next_wakeup);
+	dev_pm_genpd_set_next_wakeup(cluster_gov->dev, next_wakeup);
 }
 
 /**
@@ -487,24 +523,37 @@ static void cluster_gov_reflect(struct lpm_cpu *cpu_gov)
  * update_cluster_select() - This will be called when cpu is going to lpm to update
  *			   its next wakeup value to corresponding cluster domain device.
  * @cpu_gov: CPU's lpm data structure.
+ *
+ * Each cpu only writes its own next wakeup, so no lock is taken. A cpu that
+ * publishes the cluster's next wakeup recomputes it for as long as other cpus
+ * updated theirs meanwhile, so the last value published accounts for all cpus.
  */
 static void update_cluster_select(struct lpm_cpu *cpu_gov)
 {
 	struct generic_pm_domain *genpd;
 	struct lpm_cluster *cluster_gov;
 	int cpu = cpu_gov->cpu;
+	int seq, cur;
+
+	WRITE_ONCE(per_cpu(cpu_next_wakeup, cpu), cpu_gov->next_wakeup);
+	WRITE_ONCE(per_cpu(cpu_next_event, cpu), cpu_gov->next_event);
 
 	list_for_each_entry(cluster_gov, &cluster_dev_list, list) {
 		if (!cluster_gov->initialized)
 			continue;
 
 		genpd = cluster_gov->genpd;
-		if (cpumask_test_cpu(cpu, genpd->cpus)) {
-			spin_lock(&cluster_gov->lock);
-			cluster_gov->now = cpu_gov->now;
-			per_cpu(cpu_next_wakeup, cpu) = cpu_gov->next_wakeup;
+		if (!cpumask_test_cpu(cpu, genpd->cpus))
+			continue;
+
+		seq = atomic_inc_return(&cluster_gov->next_event.seq);
+		for (;;) {
 			update_cluster_next_wakeup(cluster_gov);
-			spin_unlock(&cluster_gov->lock);
+			smp_mb();
+			cur = atomic_read(&cluster_gov->next_event.seq);
+			if (cur == seq)
+				break;
+			seq = cur;
 		}
 	}
 }
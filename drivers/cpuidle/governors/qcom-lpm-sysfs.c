@@ -72,6 +72,18 @@ static int create_cluster_state_node(struct device *dev, struct qcom_cluster_nod
 	return ret;
 }
 
+static ssize_t cluster_stats_show(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  char *buf)
+{
+	struct lpm_cluster *cluster = container_of(attr, struct lpm_cluster, stats_attr);
+	struct cluster_next_event *ne = &cluster->next_event;
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "timers_started: %llu\ntimers_avoided: %llu\ntimer_wakeups: %llu\n",
+			 ne->timers_started, ne->timers_avoided, ne->timer_wakeups);
+}
+
 void remove_cluster_sysfs_nodes(struct lpm_cluster *cluster)
 {
 	struct generic_pm_domain *genpd = cluster->genpd;
@@ -103,6 +115,16 @@ int create_cluster_sysfs_nodes(struct lpm_cluster *cluster)
 	if (!cluster->dev_kobj)
 		return -ENOMEM;
 
+	sysfs_attr_init(&cluster->stats_attr.attr);
+	cluster->stats_attr.attr.name = "stats";
+	cluster->stats_attr.attr.mode = 0444;
+	cluster->stats_attr.show = cluster_stats_show;
+	ret = sysfs_create_file(cluster->dev_kobj, &cluster->stats_attr.attr);
+	if (ret) {
+		kobject_put(cluster->dev_kobj);
+		return ret;
+	}
+
 	for (i = 0; i < genpd->state_count; i++) {
 		struct qcom_cluster_node *d;
 
@@ -184,12 +206,65 @@ static ssize_t prediction_disabled_store(struct kobject *kobj,
 	return count;
 }
 
+static ssize_t irq_prediction_disabled_show(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", irq_prediction_disabled);
+}
+
+static ssize_t irq_prediction_disabled_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret) {
+		pr_err("Invalid argument passed\n");
+		return ret;
+	}
+
+	irq_prediction_disabled = val;
+
+	return count;
+}
+
+static ssize_t pred_stats_show(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       char *buf)
+{
+	struct pred_stats *stats;
+	ssize_t len;
+	int cpu;
+
+	len = scnprintf(buf, PAGE_SIZE, "%-4s %12s %12s %12s %12s %12s %12s\n",
+			"cpu", "hist_hit", "hist_deep", "hist_shallow",
+			"irq_hit", "irq_deep", "irq_shallow");
+
+	for_each_possible_cpu(cpu) {
+		stats = &per_cpu_ptr(&lpm_cpu_data, cpu)->stats;
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%-4d %12llu %12llu %12llu %12llu %12llu %12llu\n",
+				 cpu, stats->history.hit, stats->history.too_deep,
+				 stats->history.too_shallow, stats->irq.hit,
+				 stats->irq.too_deep, stats->irq.too_shallow);
+	}
+
+	return len;
+}
+
 static struct kobj_attribute attr_sleep_disabled = __ATTR_RW(sleep_disabled);
 static struct kobj_attribute attr_prediction_disabled = __ATTR_RW(prediction_disabled);
+static struct kobj_attribute attr_irq_prediction_disabled = __ATTR_RW(irq_prediction_disabled);
+static struct kobj_attribute attr_pred_stats = __ATTR_RO(pred_stats);
 
 static struct attribute *lpm_gov_attrs[] = {
 	&attr_sleep_disabled.attr,
 	&attr_prediction_disabled.attr,
+	&attr_irq_prediction_disabled.attr,
+	&attr_pred_stats.attr,
 	NULL
 };
 
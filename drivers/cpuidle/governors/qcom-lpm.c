@@ -9,6 +9,8 @@
 #include <linux/cpu.h>
 #include <linux/cpuidle.h>
 #include <linux/cpu_pm.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/pm_domain.h>
@@ -25,6 +27,7 @@
 #include <linux/tick.h>
 #include <linux/time64.h>
 #include <trace/events/ipi.h>
+#include <trace/events/irq.h>
 #include <trace/events/power.h>
 #include <trace/hooks/cpuidle.h>
 
@@ -36,6 +39,7 @@
 #define LPM_PRED_RESIDENCY_PATTERN		1
 #define LPM_PRED_PREMATURE_EXITS		2
 #define LPM_PRED_IPI_PATTERN			3
+#define LPM_PRED_IRQ_PATTERN			4
 
 #define LPM_SELECT_STATE_DISABLED		0
 #define LPM_SELECT_STATE_QOS_UNMET		1
@@ -48,6 +52,7 @@
 #define UPDATE_REASON(i, u)			(BIT(u) << (MAX_LPM_CPUS * i))
 
 bool prediction_disabled;
+bool irq_prediction_disabled;
 bool sleep_disabled = true;
 static bool suspend_in_progress;
 static bool traces_registered;
@@ -231,39 +236,176 @@ static uint64_t find_deviation(struct lpm_cpu *cpu_gov, int *samples_history,
 }
 
 /**
- * cpu_predict() - Predict the cpus next wakeup.
+ * predict_irq_wakeup() - Predict the next wakeup from the periodic interrupts
+ *			  handled by the cpu. An interrupt source is periodic
+ *			  when the deviation of its inter-arrival time is
+ *			  small compared to the interval itself.
  * @cpu_gov:  targeted cpu's lpm data structure
  * @duration_ns:  cpu's scheduler sleep length
+ *
+ * Return: time in usec until the earliest periodic interrupt is expected,
+ *	   minus its deviation, or 0 if no prediction can be made.
  */
-static void cpu_predict(struct lpm_cpu *cpu_gov, u64 duration_ns)
+static uint64_t predict_irq_wakeup(struct lpm_cpu *cpu_gov, u64 duration_ns)
 {
-	int i, j;
+	struct history_irq *irq_history = &cpu_gov->irq_history;
 	struct cpuidle_driver *drv = cpu_gov->drv;
-	struct cpuidle_state *min_state = &drv->states[0];
-	struct history_lpm *lpm_history = &cpu_gov->lpm_history;
-	struct history_ipi *ipi_history = &cpu_gov->ipi_history;
+	struct cpuidle_state *max_state = &drv->states[drv->state_count - 1];
+	uint64_t since, remaining, next = U64_MAX;
+	int i;
 
-	if (prediction_disabled)
+	for (i = 0; i < MAX_IRQ_SOURCES; i++) {
+		struct irq_source *src = &irq_history->src[i];
+
+		if (src->nsamp < IRQ_PRED_MIN_SAMPLES || !src->interval ||
+		    src->deviation * IRQ_PRED_JITTER_RATIO > src->interval)
+			continue;
+
+		/* Skip sources that missed their last period */
+		since = ktime_to_us(ktime_sub(cpu_gov->now, src->last));
+		if (since >= src->interval + src->deviation)
+			continue;
+
+		remaining = since < src->interval ? src->interval - since : 0;
+		remaining = remaining > src->deviation ?
+			    remaining - src->deviation : 1;
+		if (remaining < next)
+			next = remaining;
+	}
+
+	do_div(duration_ns, NSEC_PER_USEC);
+	if (next >= duration_ns || next > max_state->target_residency)
+		return 0;
+
+	return next;
+}
+
+/**
+ * update_irq_history() - Update the inter-arrival statistics of an interrupt
+ *			  source handled by the cpu.
+ * @cpu_gov:  cpu's lpm data structure
+ * @irq:  interrupt number
+ * @now:  arrival time of the interrupt
+ */
+static void update_irq_history(struct lpm_cpu *cpu_gov, int irq, ktime_t now)
+{
+	struct history_irq *irq_history = &cpu_gov->irq_history;
+	struct irq_source *src = NULL, *oldest = &irq_history->src[0];
+	int64_t delta, diff;
+	int i;
+
+	for (i = 0; i < MAX_IRQ_SOURCES; i++) {
+		if (irq_history->src[i].irq == irq && irq_history->src[i].last) {
+			src = &irq_history->src[i];
+			break;
+		}
+
+		if (ktime_before(irq_history->src[i].last, oldest->last))
+			oldest = &irq_history->src[i];
+	}
+
+	/* Track the new source in place of the least recently seen one */
+	if (!src) {
+		oldest->irq = irq;
+		oldest->nsamp = 0;
+		oldest->last = now;
 		return;
+	}
 
-	/*
-	 * Samples are marked invalid when woken-up due to timer,
-	 * so do not predict.
-	 */
-	if (cpu_gov->history_invalid) {
-		cpu_gov->history_invalid = false;
-		cpu_gov->htmr_wkup = true;
-		cpu_gov->next_pred_time = 0;
+	delta = ktime_to_us(ktime_sub(now, src->last));
+	src->last = now;
+
+	if (delta > IRQ_PRED_MAX_INTERVAL) {
+		src->nsamp = 0;
 		return;
 	}
 
-	/*
-	 * If the duration_ns itself is not sufficient for deeper
-	 * low power modes than clock gating do not predict
-	 */
-	if (min_state->target_residency_ns > duration_ns)
+	if (!src->nsamp) {
+		src->interval = delta;
+		src->deviation = 0;
+	} else {
+		/* Moving averages with weights of 1/8 and 1/4 */
+		diff = delta - src->interval;
+		src->interval += diff / 8;
+		src->deviation += (abs(diff) - (int64_t)src->deviation) / 4;
+	}
+
+	if (src->nsamp < U32_MAX)
+		src->nsamp++;
+}
+
+/**
+ * pred_state_idx() - Find the deepest state whose residency fits in a sleep.
+ * @drv:  cpuidle driver
+ * @sleep_us:  expected or measured sleep length
+ */
+static int pred_state_idx(struct cpuidle_driver *drv, uint64_t sleep_us)
+{
+	int i;
+
+	for (i = drv->state_count - 1; i > 0; i--)
+		if (drv->states[i].target_residency <= sleep_us)
+			break;
+
+	return i;
+}
+
+static void score_prediction(struct cpuidle_driver *drv,
+			     struct pred_score *score, uint64_t pred_us,
+			     uint64_t duration_us, int best)
+{
+	int idx;
+
+	if (!pred_us || pred_us > duration_us)
+		pred_us = duration_us;
+
+	idx = pred_state_idx(drv, pred_us);
+	if (idx > best)
+		score->too_deep++;
+	else if (idx < best)
+		score->too_shallow++;
+	else
+		score->hit++;
+}
+
+/**
+ * score_predictions() - Score the residency history and the interrupt based
+ *			 predictions of the last idle period against the
+ *			 state its measured residency would have allowed.
+ *			 Both predictors are scored whichever one was used.
+ * @cpu_gov:  targeted cpu's lpm data structure
+ * @measured_us:  measured residency of the last idle period
+ */
+static void score_predictions(struct lpm_cpu *cpu_gov, uint64_t measured_us)
+{
+	struct pred_stats *stats = &cpu_gov->stats;
+	struct cpuidle_driver *drv = cpu_gov->drv;
+	int best;
+
+	if (!stats->valid)
 		return;
 
+	stats->valid = false;
+	best = pred_state_idx(drv, measured_us);
+	score_prediction(drv, &stats->history, stats->history_pred,
+			 stats->duration, best);
+	score_prediction(drv, &stats->irq, stats->irq_pred,
+			 stats->duration, best);
+}
+
+/**
+ * cpu_predict_history() - Predict the cpus next wakeup from the history of
+ *			   its residencies and IPIs.
+ * @cpu_gov:  targeted cpu's lpm data structure
+ * @duration_ns:  cpu's scheduler sleep length
+ */
+static void cpu_predict_history(struct lpm_cpu *cpu_gov, u64 duration_ns)
+{
+	int i, j;
+	struct cpuidle_driver *drv = cpu_gov->drv;
+	struct history_lpm *lpm_history = &cpu_gov->lpm_history;
+	struct history_ipi *ipi_history = &cpu_gov->ipi_history;
+
 	/* Predict only when all the samples are collected */
 	if (lpm_history->nsamp < MAXSAMPLES) {
 		cpu_gov->next_pred_time = 0;
@@ -320,6 +462,56 @@ static void cpu_predict(struct lpm_cpu *cpu_gov, u64 duration_ns)
 		cpu_gov->pred_type = LPM_PRED_IPI_PATTERN;
 }
 
+/**
+ * cpu_predict() - Predict the cpus next wakeup.
+ * @cpu_gov:  targeted cpu's lpm data structure
+ * @duration_ns:  cpu's scheduler sleep length
+ */
+static void cpu_predict(struct lpm_cpu *cpu_gov, u64 duration_ns)
+{
+	struct cpuidle_state *min_state = &cpu_gov->drv->states[0];
+	struct pred_stats *stats = &cpu_gov->stats;
+	uint64_t irq_pred;
+
+	if (prediction_disabled)
+		return;
+
+	/*
+	 * Samples are marked invalid when woken-up due to timer,
+	 * so do not predict.
+	 */
+	if (cpu_gov->history_invalid) {
+		cpu_gov->history_invalid = false;
+		cpu_gov->htmr_wkup = true;
+		cpu_gov->next_pred_time = 0;
+		return;
+	}
+
+	/*
+	 * If the duration_ns itself is not sufficient for deeper
+	 * low power modes than clock gating do not predict
+	 */
+	if (min_state->target_residency_ns > duration_ns)
+		return;
+
+	irq_pred = predict_irq_wakeup(cpu_gov, duration_ns);
+	cpu_predict_history(cpu_gov, duration_ns);
+
+	stats->history_pred = cpu_gov->predicted;
+	stats->irq_pred = irq_pred;
+	stats->duration = div_u64(duration_ns, NSEC_PER_USEC);
+	stats->valid = true;
+
+	/* A periodic interrupt expected earlier wins over the history */
+	if (irq_prediction_disabled || !irq_pred ||
+	    (cpu_gov->predicted && cpu_gov->predicted <= irq_pred))
+		return;
+
+	cpu_gov->predicted = irq_pred;
+	cpu_gov->next_pred_time = ktime_to_us(cpu_gov->now) + irq_pred;
+	cpu_gov->pred_type = LPM_PRED_IRQ_PATTERN;
+}
+
 /**
  * clear_cpu_predict_history() - Clears the stored previous samples data.
  *			       It will be called when APSS going to deep sleep.
@@ -369,6 +561,9 @@ static void update_cpu_history(struct lpm_cpu *cpu_gov)
 	if (measured_us > target->exit_latency)
 		measured_us -= target->exit_latency;
 
+	if (!cpu_gov->htmr_wkup)
+		score_predictions(cpu_gov, measured_us);
+
 	if (cpu_gov->htmr_wkup) {
 		if (!lpm_history->samples_idx)
 			lpm_history->samples_idx = MAXSAMPLES - 1;
@@ -506,6 +701,28 @@ static void ipi_entry(void *ignore, const char *unused)
 	spin_unlock_irqrestore(&cpu_gov->lock, flags);
 }
 
+static void irq_entry(void *ignore, int irq, struct irqaction *action)
+{
+	struct lpm_cpu *cpu_gov = this_cpu_ptr(&lpm_cpu_data);
+	struct irq_data *d;
+
+	if (suspend_in_progress || !cpu_gov->enable)
+		return;
+
+	/*
+	 * Only track device interrupts. Per-CPU ones such as the arch timer
+	 * are already covered by the next timer event.
+	 */
+	if (action->flags & IRQF_PERCPU)
+		return;
+
+	d = irq_get_irq_data(irq);
+	if (!d || irqd_is_per_cpu(d))
+		return;
+
+	update_irq_history(cpu_gov, irq, ktime_get());
+}
+
 /**
  * get_cpus_qos() - Returns the aggrigated PM QoS request.
  * @mask: cpumask of the cpus
@@ -634,6 +851,7 @@ static int lpm_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	do_div(duration_ns, NSEC_PER_USEC);
 	cpu_gov->last_idx = i;
 	cpu_gov->next_wakeup = ktime_add_us(cpu_gov->now, duration_ns);
+	cpu_gov->next_event = cpu_gov->next_wakeup;
 	htime = start_prediction_timer(cpu_gov, duration_ns);
 
 	/* update this cpu next_wakeup into its parent power domain device */
@@ -778,6 +996,17 @@ static int lpm_enable_device(struct cpuidle_driver *drv,
 			return ret;
 		}
 
+		ret = register_trace_irq_handler_entry(irq_entry, NULL);
+		if (ret) {
+			unregister_trace_ipi_raise(ipi_raise, NULL);
+			unregister_trace_ipi_entry(ipi_entry, NULL);
+			unregister_trace_android_vh_cpu_idle_enter(
+					lpm_idle_enter, NULL);
+			unregister_trace_android_vh_cpu_idle_exit(
+					lpm_idle_exit, NULL);
+			return ret;
+		}
+
 		if (cluster_gov_ops && cluster_gov_ops->enable)
 			cluster_gov_ops->enable();
 
@@ -820,6 +1049,7 @@ static void lpm_disable_device(struct cpuidle_driver *drv,
 					lpm_idle_enter, NULL);
 		unregister_trace_android_vh_cpu_idle_exit(
 					lpm_idle_exit, NULL);
+		unregister_trace_irq_handler_entry(irq_entry, NULL);
 		if (cluster_gov_ops && cluster_gov_ops->disable)
 			cluster_gov_ops->disable();
 
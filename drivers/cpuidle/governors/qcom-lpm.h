@@ -17,9 +17,14 @@
 #define CLUST_SMPL_INVLD_TIME	40000
 #define CLUST_BIAS_TIME_MSEC	10
 #define MAX_CLUSTER_STATES	4
+#define MAX_IRQ_SOURCES		8
+#define IRQ_PRED_MIN_SAMPLES	4
+#define IRQ_PRED_MAX_INTERVAL	USEC_PER_SEC
+#define IRQ_PRED_JITTER_RATIO	4
 
 extern bool sleep_disabled;
 extern bool prediction_disabled;
+extern bool irq_prediction_disabled;
 
 struct qcom_cluster_node {
 	struct lpm_cluster *cluster;
@@ -43,6 +48,33 @@ struct history_ipi {
 	ktime_t cpu_idle_resched_ts;
 };
 
+struct irq_source {
+	int irq;
+	uint32_t nsamp;
+	ktime_t last;
+	uint32_t interval;
+	uint32_t deviation;
+};
+
+struct history_irq {
+	struct irq_source src[MAX_IRQ_SOURCES];
+};
+
+struct pred_score {
+	uint64_t hit;
+	uint64_t too_deep;
+	uint64_t too_shallow;
+};
+
+struct pred_stats {
+	uint64_t history_pred;
+	uint64_t irq_pred;
+	uint64_t duration;
+	bool valid;
+	struct pred_score history;
+	struct pred_score irq;
+};
+
 struct lpm_cpu {
 	int cpu;
 	int enable;
@@ -51,6 +83,7 @@ struct lpm_cpu {
 	struct cpuidle_driver *drv;
 	struct cpuidle_device *dev;
 	ktime_t next_wakeup;
+	ktime_t next_event;
 	uint64_t predicted;
 	uint32_t history_invalid;
 	bool predict_started;
@@ -59,6 +92,8 @@ struct lpm_cpu {
 	struct hrtimer biastimer;
 	struct history_lpm lpm_history;
 	struct history_ipi ipi_history;
+	struct history_irq irq_history;
+	struct pred_stats stats;
 	ktime_t now;
 	uint64_t bias;
 	int64_t next_pred_time;
@@ -73,6 +108,13 @@ struct cluster_history {
 	uint64_t entry_time;
 };
 
+struct cluster_next_event {
+	atomic_t seq;
+	uint64_t timers_started;
+	uint64_t timers_avoided;
+	uint64_t timer_wakeups;
+};
+
 struct lpm_cluster {
 	struct device *dev;
 	uint32_t samples_idx;
@@ -87,6 +129,7 @@ struct lpm_cluster {
 	struct generic_pm_domain *genpd;
 	struct qcom_cluster_node *dev_node[MAX_CLUSTER_STATES];
 	struct kobject *dev_kobj;
+	struct kobj_attribute stats_attr;
 	struct notifier_block genpd_nb;
 	struct work_struct work;
 	struct hrtimer histtimer;
@@ -95,6 +138,7 @@ struct lpm_cluster {
 	ktime_t pred_wakeup;
 	ktime_t now;
 	u64 pred_residency;
+	struct cluster_next_event next_event;
 	bool state_allowed[MAX_CLUSTER_STATES];
 	struct list_head list;
 	spinlock_t lock;
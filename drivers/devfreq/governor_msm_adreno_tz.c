@@ -54,6 +54,18 @@ static DEFINE_SPINLOCK(suspend_lock);
 
 #define TAG "msm_adreno_tz: "
 
+/*
+ * DCVS decision engines: TZ only, in-kernel only, or TZ with the in-kernel
+ * decision computed alongside it for comparison.
+ */
+#define DCVS_ENGINE_TZ		0
+#define DCVS_ENGINE_LOCAL	1
+#define DCVS_ENGINE_COMPARE	2
+
+/* Default in-kernel thresholds, in percent of GPU busy time */
+#define DCVS_UP_THRESHOLD	80
+#define DCVS_DOWN_THRESHOLD	50
+
 static u64 suspend_time;
 static u64 suspend_start;
 static unsigned long acc_total, acc_relative_busy;
@@ -149,15 +161,173 @@ static ssize_t mod_percent_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%u\n", priv->mod_percent);
 }
 
+static ssize_t dcvs_engine_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	ret = kstrtou32(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	if (val > DCVS_ENGINE_COMPARE)
+		return -EINVAL;
+
+	/* TZ history went stale while it was not being updated */
+	if (priv->dcvs.engine == DCVS_ENGINE_LOCAL && val != DCVS_ENGINE_LOCAL)
+		priv->dcvs.tz_stale = true;
+
+	priv->dcvs.engine = val;
+
+	return count;
+}
+
+static ssize_t dcvs_engine_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", priv->dcvs.engine);
+}
+
+static ssize_t dcvs_up_threshold_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	ret = kstrtou32(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	if (val > 100 || val <= priv->dcvs.down_threshold)
+		return -EINVAL;
+
+	priv->dcvs.up_threshold = val;
+
+	return count;
+}
+
+static ssize_t dcvs_up_threshold_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", priv->dcvs.up_threshold);
+}
+
+static ssize_t dcvs_down_threshold_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	ret = kstrtou32(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	if (val >= priv->dcvs.up_threshold)
+		return -EINVAL;
+
+	priv->dcvs.down_threshold = val;
+
+	return count;
+}
+
+static ssize_t dcvs_down_threshold_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", priv->dcvs.down_threshold);
+}
+
+static ssize_t dcvs_bias_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	int ret, val;
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	ret = kstrtoint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	priv->dcvs.bias = clamp_t(int, val, -100, 100);
+
+	return count;
+}
+
+static ssize_t dcvs_bias_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", priv->dcvs.bias);
+}
+
+static ssize_t dcvs_stats_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	static const char * const name[] = { "tz", "local" };
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+	ssize_t len = 0;
+	u64 avg;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(priv->dcvs.latency); i++) {
+		avg = priv->dcvs.latency[i].count ?
+			div64_u64(priv->dcvs.latency[i].total_ns,
+				  priv->dcvs.latency[i].count) : 0;
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				"%s: count=%llu avg_ns=%llu max_ns=%llu\n",
+				name[i], priv->dcvs.latency[i].count, avg,
+				priv->dcvs.latency[i].max_ns);
+	}
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			"compare: agree=%llu local_higher=%llu local_lower=%llu\n",
+			priv->dcvs.agree, priv->dcvs.local_higher,
+			priv->dcvs.local_lower);
+
+	return len;
+}
+
 static DEVICE_ATTR_RO(gpu_load);
 
 static DEVICE_ATTR_RO(suspend_time);
 static DEVICE_ATTR_RW(mod_percent);
+static DEVICE_ATTR_RW(dcvs_engine);
+static DEVICE_ATTR_RW(dcvs_up_threshold);
+static DEVICE_ATTR_RW(dcvs_down_threshold);
+static DEVICE_ATTR_RW(dcvs_bias);
+static DEVICE_ATTR_RO(dcvs_stats);
 
 static const struct device_attribute *adreno_tz_attr_list[] = {
 		&dev_attr_gpu_load,
 		&dev_attr_suspend_time,
 		&dev_attr_mod_percent,
+		&dev_attr_dcvs_engine,
+		&dev_attr_dcvs_up_threshold,
+		&dev_attr_dcvs_down_threshold,
+		&dev_attr_dcvs_bias,
+		&dev_attr_dcvs_stats,
 		NULL
 };
 
@@ -221,6 +391,85 @@ static int __secure_tz_update_entry3(int level, s64 total_time, s64 busy_time,
 	return ret;
 }
 
+/*
+ * In-kernel DCVS decision: step one level up when the biased busy
+ * percentage of the bin reaches the up threshold, and one level down
+ * when it falls below the down threshold. Level 0 is the highest
+ * frequency, so a negative return value raises the frequency.
+ */
+static int dcvs_local_update(int level, s64 total_time, s64 busy_time,
+		int max_level, struct devfreq_msm_adreno_tz_data *priv)
+{
+	s64 load = div64_s64(busy_time * 100, total_time) + priv->dcvs.bias;
+
+	if (load >= priv->dcvs.up_threshold && level > 0)
+		return -1;
+
+	if (load < priv->dcvs.down_threshold && level < max_level)
+		return 1;
+
+	return 0;
+}
+
+static void dcvs_account(struct devfreq_msm_adreno_tz_data *priv,
+		int engine, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	priv->dcvs.latency[engine].count++;
+	priv->dcvs.latency[engine].total_ns += ns;
+	priv->dcvs.latency[engine].max_ns =
+		max(priv->dcvs.latency[engine].max_ns, ns);
+}
+
+/*
+ * Get the level change for the current bin from the selected engine.
+ * TZ is only reset when it takes over again after the in-kernel engine,
+ * since its history is stale by then.
+ */
+static int dcvs_update(int level, int context_count, int max_level,
+		struct devfreq_msm_adreno_tz_data *priv)
+{
+	unsigned int scm_data[2] = {0, 0};
+	int val, local;
+	ktime_t start;
+
+	if (priv->dcvs.engine == DCVS_ENGINE_LOCAL) {
+		start = ktime_get();
+		val = dcvs_local_update(level, priv->bin.total_time,
+			priv->bin.busy_time, max_level, priv);
+		dcvs_account(priv, DCVS_ENGINE_LOCAL, start);
+		return val;
+	}
+
+	if (priv->dcvs.tz_stale) {
+		__secure_tz_reset_entry2(scm_data, sizeof(scm_data),
+			priv->is_64);
+		priv->dcvs.tz_stale = false;
+	}
+
+	start = ktime_get();
+	val = __secure_tz_update_entry3(level, priv->bin.total_time,
+		priv->bin.busy_time, context_count, priv);
+	dcvs_account(priv, DCVS_ENGINE_TZ, start);
+
+	if (priv->dcvs.engine == DCVS_ENGINE_COMPARE) {
+		start = ktime_get();
+		local = dcvs_local_update(level, priv->bin.total_time,
+			priv->bin.busy_time, max_level, priv);
+		dcvs_account(priv, DCVS_ENGINE_LOCAL, start);
+
+		if (local == val)
+			priv->dcvs.agree++;
+		else if (local < val)
+			priv->dcvs.local_higher++;
+		else
+			priv->dcvs.local_lower++;
+	}
+
+	return val;
+}
+
 static int tz_init_ca(struct device *dev,
 	struct devfreq_msm_adreno_tz_data *priv)
 {
@@ -403,8 +652,8 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq)
 			priv->bin.busy_time > CEILING) {
 		val = -1 * level;
 	} else {
-		val = __secure_tz_update_entry3(level, priv->bin.total_time,
-			priv->bin.busy_time, context_count, priv);
+		val = dcvs_update(level, context_count,
+			devfreq->profile->max_state - 1, priv);
 	}
 
 	priv->bin.total_time = 0;
@@ -446,6 +695,11 @@ static int __tz_init(struct devfreq *devfreq)
 
 	priv = devfreq->data;
 
+	if (!priv->dcvs.up_threshold) {
+		priv->dcvs.up_threshold = DCVS_UP_THRESHOLD;
+		priv->dcvs.down_threshold = DCVS_DOWN_THRESHOLD;
+	}
+
 	out = 1;
 	if (devfreq->profile->max_state < ARRAY_SIZE(tz_pwrlevels)) {
 		for (i = 0; i < devfreq->profile->max_state; i++)
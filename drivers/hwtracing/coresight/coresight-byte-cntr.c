@@ -11,6 +11,11 @@
 #include <linux/delay.h>
 #include <linux/uaccess.h>
 #include <linux/property.h>
+#include <linux/mm.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/poll.h>
+#include <linux/splice.h>
+#include <uapi/linux/coresight-byte-cntr.h>
 
 #include "coresight-priv.h"
 #include "coresight-byte-cntr.h"
@@ -192,6 +197,290 @@ static ssize_t tmc_etr_byte_cntr_read(struct file *fp, char __user *data,
 	return len;
 }
 
+/*
+ * Ring interface: the ETR SG pages are mapped straight into the reader
+ * (mmap) or handed to a pipe (splice), and byte_cntr->offset is the
+ * consumer offset shared with the read() path. The producer side is
+ * derived from the byte counter interrupts, each of which stands for
+ * block_size bytes written by the ETR.
+ */
+static u64 byte_cntr_ring_avail(struct byte_cntr *byte_cntr_data)
+{
+	struct tmc_drvdata *tmcdrvdata = byte_cntr_data->tmcdrvdata;
+	u64 avail, partial;
+	int nr_blocks, max_blocks, lost;
+
+	if (!byte_cntr_data->read_active)
+		return ((byte_cntr_data->rwp_offset < byte_cntr_data->offset) ?
+			tmcdrvdata->size : 0) + byte_cntr_data->rwp_offset -
+			byte_cntr_data->offset;
+
+	if (!byte_cntr_data->block_size ||
+	    byte_cntr_data->block_size > tmcdrvdata->size)
+		return 0;
+
+	/*
+	 * The ETR has lapped the reader, the oldest blocks are gone. Skip
+	 * over them so that the ring only reports data that is still valid.
+	 */
+	nr_blocks = atomic_read(&byte_cntr_data->irq_cnt);
+	max_blocks = tmcdrvdata->size / byte_cntr_data->block_size;
+	if (nr_blocks > max_blocks) {
+		lost = nr_blocks - max_blocks;
+		atomic_sub(lost, &byte_cntr_data->irq_cnt);
+		byte_cntr_data->ring_lost += (u64)lost * byte_cntr_data->block_size;
+		byte_cntr_data->offset = (byte_cntr_data->offset +
+				(lost % max_blocks) * byte_cntr_data->block_size) %
+				tmcdrvdata->size;
+		nr_blocks = max_blocks;
+	}
+
+	avail = (u64)nr_blocks * byte_cntr_data->block_size;
+	partial = byte_cntr_data->offset % byte_cntr_data->block_size;
+
+	return avail > partial ? avail - partial : 0;
+}
+
+static void byte_cntr_ring_consume(struct byte_cntr *byte_cntr_data, u64 len)
+{
+	struct tmc_drvdata *tmcdrvdata = byte_cntr_data->tmcdrvdata;
+	u64 blocks;
+
+	if (byte_cntr_data->read_active && byte_cntr_data->block_size) {
+		blocks = div_u64(byte_cntr_data->offset %
+				 byte_cntr_data->block_size + len,
+				 byte_cntr_data->block_size);
+		while (blocks-- &&
+		       atomic_add_unless(&byte_cntr_data->irq_cnt, -1, 0))
+			;
+	}
+
+	byte_cntr_data->total_size += len;
+	byte_cntr_data->offset = (byte_cntr_data->offset +
+				  (unsigned long)len) % tmcdrvdata->size;
+}
+
+static long tmc_etr_byte_cntr_ring_info(struct byte_cntr *byte_cntr_data,
+					void __user *arg)
+{
+	struct tmc_drvdata *tmcdrvdata = byte_cntr_data->tmcdrvdata;
+	struct byte_cntr_ring_info info = {};
+
+	mutex_lock(&byte_cntr_data->byte_cntr_lock);
+	if (!tmcdrvdata->sysfs_buf) {
+		mutex_unlock(&byte_cntr_data->byte_cntr_lock);
+		return -EINVAL;
+	}
+
+	info.size = tmcdrvdata->size;
+	info.tail = byte_cntr_data->offset;
+	info.avail = byte_cntr_ring_avail(byte_cntr_data);
+	info.head = (byte_cntr_data->offset + (unsigned long)info.avail) %
+		    tmcdrvdata->size;
+	info.lost = byte_cntr_data->ring_lost;
+	info.block_size = byte_cntr_data->block_size;
+	if (!byte_cntr_data->read_active)
+		info.flags |= BYTE_CNTR_RING_STOPPED;
+
+	tmc_etr_buf_sync_range(tmcdrvdata->sysfs_buf, info.tail, info.avail);
+	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
+
+	if (copy_to_user(arg, &info, sizeof(info)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long tmc_etr_byte_cntr_ring_consume(struct byte_cntr *byte_cntr_data,
+					   u64 __user *arg)
+{
+	u64 len;
+	long ret = 0;
+
+	if (get_user(len, arg))
+		return -EFAULT;
+
+	mutex_lock(&byte_cntr_data->byte_cntr_lock);
+	if (len > byte_cntr_ring_avail(byte_cntr_data))
+		ret = -EINVAL;
+	else
+		byte_cntr_ring_consume(byte_cntr_data, len);
+	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
+
+	return ret;
+}
+
+static long tmc_etr_byte_cntr_ioctl(struct file *fp, unsigned int cmd,
+				    unsigned long arg)
+{
+	struct byte_cntr *byte_cntr_data = fp->private_data;
+
+	switch (cmd) {
+	case BYTE_CNTR_IOC_RING_INFO:
+		return tmc_etr_byte_cntr_ring_info(byte_cntr_data,
+						   (void __user *)arg);
+	case BYTE_CNTR_IOC_RING_CONSUME:
+		return tmc_etr_byte_cntr_ring_consume(byte_cntr_data,
+						      (u64 __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static __poll_t tmc_etr_byte_cntr_poll(struct file *fp, poll_table *wait)
+{
+	struct byte_cntr *byte_cntr_data = fp->private_data;
+
+	poll_wait(fp, &byte_cntr_data->wq, wait);
+
+	if (atomic_read(&byte_cntr_data->irq_cnt) > 0 ||
+	    !byte_cntr_data->enable)
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static int tmc_etr_byte_cntr_mmap(struct file *fp, struct vm_area_struct *vma)
+{
+	struct byte_cntr *byte_cntr_data = fp->private_data;
+	struct tmc_drvdata *tmcdrvdata = byte_cntr_data->tmcdrvdata;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long off;
+	struct page *page;
+	int ret = 0;
+
+	/* The trace buffer belongs to the ETR, readers only get to look */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (vma->vm_pgoff || size > tmcdrvdata->size)
+		return -EINVAL;
+
+	mutex_lock(&byte_cntr_data->byte_cntr_lock);
+	if (!tmcdrvdata->sysfs_buf) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	vm_flags_mod(vma, VM_DONTEXPAND | VM_DONTDUMP, VM_MAYWRITE);
+
+	for (off = 0; off < size; off += PAGE_SIZE) {
+		page = tmc_etr_buf_get_page(tmcdrvdata->sysfs_buf, off);
+		if (!page) {
+			ret = -EOPNOTSUPP;
+			break;
+		}
+
+		ret = vm_insert_page(vma, vma->vm_start + off, page);
+		if (ret)
+			break;
+	}
+out:
+	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
+	return ret;
+}
+
+static void byte_cntr_pipe_buf_release(struct pipe_inode_info *pipe,
+				       struct pipe_buffer *buf)
+{
+	put_page(buf->page);
+}
+
+static const struct pipe_buf_operations byte_cntr_pipe_buf_ops = {
+	.release	= byte_cntr_pipe_buf_release,
+	.get		= generic_pipe_buf_get,
+};
+
+static void byte_cntr_spd_release(struct splice_pipe_desc *spd, unsigned int i)
+{
+	put_page(spd->pages[i]);
+}
+
+/*
+ * The ETR keeps writing into the spliced pages, so the data in the pipe is
+ * only valid until the ETR wraps around. Readers splicing out of here are
+ * expected to drain the pipe at least once per buffer lap.
+ */
+static ssize_t tmc_etr_byte_cntr_splice_read(struct file *fp, loff_t *ppos,
+					     struct pipe_inode_info *pipe,
+					     size_t len, unsigned int flags)
+{
+	struct byte_cntr *byte_cntr_data = fp->private_data;
+	struct tmc_drvdata *tmcdrvdata = byte_cntr_data->tmcdrvdata;
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd = {
+		.pages		= pages,
+		.partial	= partial,
+		.nr_pages_max	= PIPE_DEF_BUFFERS,
+		.ops		= &byte_cntr_pipe_buf_ops,
+		.spd_release	= byte_cntr_spd_release,
+	};
+	struct page *page;
+	u64 avail, off;
+	size_t poff, plen;
+	ssize_t ret;
+
+	mutex_lock(&byte_cntr_data->byte_cntr_lock);
+	while (!(avail = byte_cntr_ring_avail(byte_cntr_data))) {
+		if (!byte_cntr_data->read_active) {
+			ret = 0;
+			goto out;
+		}
+		mutex_unlock(&byte_cntr_data->byte_cntr_lock);
+
+		if (flags & SPLICE_F_NONBLOCK)
+			return -EAGAIN;
+
+		if (wait_event_interruptible(byte_cntr_data->wq,
+				atomic_read(&byte_cntr_data->irq_cnt) > 0 ||
+				!byte_cntr_data->enable))
+			return -ERESTARTSYS;
+
+		mutex_lock(&byte_cntr_data->byte_cntr_lock);
+	}
+
+	if (!tmcdrvdata->sysfs_buf) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	len = min_t(u64, len, avail);
+	tmc_etr_buf_sync_range(tmcdrvdata->sysfs_buf,
+			       byte_cntr_data->offset, len);
+
+	off = byte_cntr_data->offset;
+	while (len && spd.nr_pages < spd.nr_pages_max) {
+		page = tmc_etr_buf_get_page(tmcdrvdata->sysfs_buf, off);
+		if (!page)
+			break;
+
+		poff = off & ~PAGE_MASK;
+		plen = min_t(size_t, len, PAGE_SIZE - poff);
+
+		get_page(page);
+		pages[spd.nr_pages] = page;
+		partial[spd.nr_pages].offset = poff;
+		partial[spd.nr_pages].len = plen;
+		spd.nr_pages++;
+
+		len -= plen;
+		off = (off + plen) % tmcdrvdata->size;
+	}
+
+	if (!spd.nr_pages) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	ret = splice_to_pipe(pipe, &spd);
+	if (ret > 0)
+		byte_cntr_ring_consume(byte_cntr_data, ret);
+out:
+	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
+	return ret;
+}
+
 void tmc_etr_byte_cntr_start(struct byte_cntr *byte_cntr_data)
 {
 	if (!byte_cntr_data)
@@ -293,6 +582,7 @@ static int tmc_etr_byte_cntr_open(struct inode *in, struct file *fp)
 	byte_cntr_data->total_size = 0;
 	byte_cntr_data->offset = tmc_get_rwp_offset(tmcdrvdata);
 	byte_cntr_data->total_irq = 0;
+	byte_cntr_data->ring_lost = 0;
 	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
 	return 0;
 }
@@ -302,6 +592,11 @@ static const struct file_operations byte_cntr_fops = {
 	.open		= tmc_etr_byte_cntr_open,
 	.read		= tmc_etr_byte_cntr_read,
 	.release	= tmc_etr_byte_cntr_release,
+	.unlocked_ioctl	= tmc_etr_byte_cntr_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.poll		= tmc_etr_byte_cntr_poll,
+	.mmap		= tmc_etr_byte_cntr_mmap,
+	.splice_read	= tmc_etr_byte_cntr_splice_read,
 	.llseek		= no_llseek,
 };
 
@@ -37,6 +37,7 @@ struct byte_cntr {
 	unsigned long		rwp_offset;
 	uint64_t		total_size;
 	uint64_t		total_irq;
+	uint64_t		ring_lost;
 };
 
 extern void tmc_etr_byte_cntr_start(struct byte_cntr *byte_cntr_data);
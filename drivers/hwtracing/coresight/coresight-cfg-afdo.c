@@ -149,5 +149,38 @@ struct cscfg_config_desc afdo_etm4x = {
 	.presets = &afdo_presets[0][0],
 };
 
+/*
+ * create an autofdo sampling configuration for continuous collection.
+ *
+ * Short trace bursts at a low mark / space ratio keep the trace bandwidth
+ * and the ETR fill rate low enough to leave tracing on in production. The
+ * sink is expected to be used as a rotating buffer through perf AUX
+ * snapshot mode, snapshots being turned into branch samples on the host
+ * with perf inject --itrace.
+ */
+#define AFDO_SAMPLE_NR_PRESETS	6
+
+static u64 afdo_sample_presets[AFDO_SAMPLE_NR_PRESETS][AFDO_NR_PARAMS] = {
+	{ 1000, 1000 },
+	{ 1000, 4000 },
+	{ 1000, 16000 },
+	{ 2000, 1000 },
+	{ 2000, 4000 },
+	{ 2000, 16000 },
+};
+
+struct cscfg_config_desc afdo_sample_etm4x = {
+	.name = "autofdo_sample",
+	.description = "Setup ETMs with short strobing bursts for continuous autofdo sampling\n"
+	"Use with perf AUX snapshot mode (perf record --snapshot) as a rotating buffer,\n"
+	"then perf inject --itrace=i64il to generate branch samples from the snapshots\n"
+	"Presets select 1000 or 2000 cycle bursts every 1000, 4000 or 16000 windows\n",
+	.nr_feat_refs = ARRAY_SIZE(afdo_ref_names),
+	.feat_ref_names = afdo_ref_names,
+	.nr_presets = AFDO_SAMPLE_NR_PRESETS,
+	.nr_total_params = AFDO_NR_PARAMS,
+	.presets = &afdo_sample_presets[0][0],
+};
+
 /* end of ETM4x configurations */
 #endif	/* IS_ENABLED(CONFIG_CORESIGHT_SOURCE_ETM4X) */
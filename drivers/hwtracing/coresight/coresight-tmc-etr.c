@@ -982,6 +982,58 @@ ssize_t tmc_etr_buf_get_data(struct etr_buf *etr_buf,
 	return etr_buf->ops->get_data(etr_buf, (u64)offset, len, bufpp);
 }
 
+/*
+ * tmc_etr_buf_get_page: Get the data page backing @offset of the buffer.
+ * Returns NULL if the buffer is not made of individual pages (e.g, FLAT),
+ * in which case it cannot be mapped or spliced page by page.
+ */
+struct page *tmc_etr_buf_get_page(struct etr_buf *etr_buf, u64 offset)
+{
+	struct etr_sg_table *etr_table;
+	struct tmc_pages *data_pages;
+
+	if (etr_buf->mode != ETR_MODE_ETR_SG || offset >= etr_buf->size)
+		return NULL;
+
+	etr_table = etr_buf->private;
+	data_pages = &etr_table->sg_table->data_pages;
+	return data_pages->pages[offset >> PAGE_SHIFT];
+}
+
+/*
+ * tmc_etr_buf_sync_range: Make @size bytes of trace data at @offset
+ * visible to the CPU, wrapping around the end of the buffer.
+ */
+void tmc_etr_buf_sync_range(struct etr_buf *etr_buf, u64 offset, u64 size)
+{
+	struct etr_flat_buf *flat_buf;
+	struct etr_sg_table *etr_table;
+	struct device *real_dev;
+	u64 len;
+
+	if (!size)
+		return;
+
+	switch (etr_buf->mode) {
+	case ETR_MODE_ETR_SG:
+		etr_table = etr_buf->private;
+		tmc_sg_table_sync_data_range(etr_table->sg_table, offset, size);
+		break;
+	case ETR_MODE_FLAT:
+		flat_buf = etr_buf->private;
+		real_dev = flat_buf->dev->parent;
+		len = min_t(u64, size, etr_buf->size - offset);
+		dma_sync_single_for_cpu(real_dev, flat_buf->daddr + offset,
+					len, DMA_FROM_DEVICE);
+		if (len < size)
+			dma_sync_single_for_cpu(real_dev, flat_buf->daddr,
+						size - len, DMA_FROM_DEVICE);
+		break;
+	default:
+		break;
+	}
+}
+
 static inline s64
 tmc_etr_buf_insert_barrier_packet(struct etr_buf *etr_buf, u64 offset)
 {
@@ -315,6 +315,8 @@ ssize_t tmc_etb_get_sysfs_trace(struct tmc_drvdata *drvdata,
 				loff_t pos, size_t len, char **bufpp);
 ssize_t tmc_etr_buf_get_data(struct etr_buf *etr_buf,
 				u64 offset, size_t len, char **bufpp);
+struct page *tmc_etr_buf_get_page(struct etr_buf *etr_buf, u64 offset);
+void tmc_etr_buf_sync_range(struct etr_buf *etr_buf, u64 offset, u64 size);
 /* ETR functions */
 int tmc_read_prepare_etr(struct tmc_drvdata *drvdata);
 int tmc_read_unprepare_etr(struct tmc_drvdata *drvdata);
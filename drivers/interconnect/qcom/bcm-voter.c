@@ -5,11 +5,16 @@
  */
 
 #include <asm/div64.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/interconnect-provider.h>
+#include <linux/ktime.h>
 #include <linux/list_sort.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/wait_bit.h>
 
 #include <soc/qcom/rpmh.h>
 #include <soc/qcom/tcs.h>
@@ -23,6 +28,24 @@
 static LIST_HEAD(bcm_voters);
 static DEFINE_MUTEX(bcm_voter_lock);
 
+/**
+ * struct bcm_voter_stats - commit statistics of a bcm voter
+ * @commits: number of commits sent to hardware
+ * @skipped: number of commits dropped because no vote changed
+ * @bcms_sent: number of bcms sent to hardware over all commits
+ * @bcms_skipped: number of queued bcms dropped because their vote was unchanged
+ * @total_ns: total time spent sending commits to hardware
+ * @max_ns: longest time spent sending a single commit to hardware
+ */
+struct bcm_voter_stats {
+	u64 commits;
+	u64 skipped;
+	u64 bcms_sent;
+	u64 bcms_skipped;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 /**
  * struct bcm_voter - Bus Clock Manager voter
  * @dev: reference to the device that communicates with the BCM
@@ -31,7 +54,11 @@ static DEFINE_MUTEX(bcm_voter_lock);
  * @commit_list: list containing bcms to be committed to hardware
  * @ws_list: list containing bcms that have different wake/sleep votes
  * @voter_node: list of bcm voters
+ * @stats: commit statistics, protected by @lock
+ * @gen: generation of the votes sent to hardware, bumped on failed commits
  * @tcs_wait: mask for which buckets require TCS completion
+ * @amc_pending: number of queued AMC requests not complete yet
+ * @amc_failed: set when a queued AMC request failed
  * @has_amc: flag to determine if this voter supports AMC
  */
 struct bcm_voter {
@@ -42,7 +69,11 @@ struct bcm_voter {
 	struct list_head commit_list;
 	struct list_head ws_list;
 	struct list_head voter_node;
+	struct bcm_voter_stats stats;
+	u32 gen;
 	u32 tcs_wait;
+	atomic_t amc_pending;
+	atomic_t amc_failed;
 	bool has_amc;
 };
 
@@ -317,6 +348,42 @@ static void qcom_icc_bcm_log(struct bcm_voter *voter, enum rpmh_state state,
 		trace_bcm_voter_commit(rpmh_state[state], cmd);
 }
 
+static void bcm_voter_amc_done(void *data, int err)
+{
+	struct bcm_voter *voter = data;
+
+	if (err)
+		atomic_set(&voter->amc_failed, 1);
+
+	if (atomic_dec_and_test(&voter->amc_pending))
+		wake_up_var(&voter->amc_pending);
+}
+
+/*
+ * When no AMC command waits for completion, the votes only need to reach
+ * hardware in order, so queue them instead of waiting for a free TCS and
+ * for the acknowledgment of each batch. A failure is picked up by the next
+ * commit.
+ */
+static int commit_amc_queued(struct bcm_voter *voter, const struct tcs_cmd *cmds,
+			     const int *commit_idx)
+{
+	int i, ret, off = 0;
+
+	for (i = 0; commit_idx[i]; i++) {
+		atomic_inc(&voter->amc_pending);
+		ret = rpmh_write_queued(voter->dev, &cmds[off], commit_idx[i],
+					bcm_voter_amc_done, voter);
+		if (ret) {
+			bcm_voter_amc_done(voter, 0);
+			return ret;
+		}
+		off += commit_idx[i];
+	}
+
+	return 0;
+}
+
 static int commit_rpmh(struct bcm_voter *voter)
 {
 	struct qcom_icc_bcm *bcm;
@@ -345,8 +412,11 @@ static int commit_rpmh(struct bcm_voter *voter)
 			goto out;
 
 		qcom_icc_bcm_log(voter, RPMH_ACTIVE_ONLY_STATE, cmds, commit_idx);
-		ret = rpmh_write_batch(voter->dev, RPMH_ACTIVE_ONLY_STATE,
-				       cmds, commit_idx);
+		if (voter->tcs_wait & BIT(QCOM_ICC_BUCKET_AMC))
+			ret = rpmh_write_batch(voter->dev, RPMH_ACTIVE_ONLY_STATE,
+					       cmds, commit_idx);
+		else
+			ret = commit_amc_queued(voter, cmds, commit_idx);
 
 		/*
 		 * Ignore -EBUSY for AMC requests, since this can only happen for AMC
@@ -482,6 +552,28 @@ static int commit_crm(struct bcm_voter *voter)
 	return 0;
 }
 
+/*
+ * Returns true if the aggregated votes of @bcm match what was last sent to
+ * hardware in every bucket, recording the new votes as sent otherwise.
+ */
+static bool bcm_vote_unchanged(struct bcm_voter *voter, struct qcom_icc_bcm *bcm)
+{
+	int bucket;
+
+	if (bcm->sent_gen == voter->gen &&
+	    !memcmp(bcm->sent_x, bcm->vote_x, sizeof(bcm->sent_x)) &&
+	    !memcmp(bcm->sent_y, bcm->vote_y, sizeof(bcm->sent_y)))
+		return true;
+
+	for (bucket = 0; bucket < QCOM_ICC_NUM_BUCKETS; bucket++) {
+		bcm->sent_x[bucket] = bcm->vote_x[bucket];
+		bcm->sent_y[bucket] = bcm->vote_y[bucket];
+	}
+	bcm->sent_gen = voter->gen;
+
+	return false;
+}
+
 /**
  * qcom_icc_bcm_voter_commit - generates and commits tcs cmds based on bcms
  * @voter: voter that needs flushing
@@ -492,13 +584,22 @@ static int commit_crm(struct bcm_voter *voter)
  * through multiple commit requests and bcm nodes are removed only when the
  * requirements for WAKE matches SLEEP.
  *
+ * BCMs whose aggregated votes are unchanged since the last commit are dropped
+ * from the commit list, and nothing is sent when no vote changed at all. A
+ * single bandwidth request commits the voter once per hop of its path, so
+ * only the first of those commits reaches hardware.
+ *
  * Returns 0 on success, or an appropriate error code otherwise.
  */
 int qcom_icc_bcm_voter_commit(struct bcm_voter *voter)
 {
+	struct bcm_voter_stats *stats;
 	struct qcom_icc_bcm *bcm;
 	struct qcom_icc_bcm *bcm_tmp;
-	int ret;
+	u64 queued = 0, sent = 0;
+	ktime_t start;
+	s64 elapsed;
+	int ret = 0;
 
 	if (!voter)
 		return 0;
@@ -507,22 +608,58 @@ int qcom_icc_bcm_voter_commit(struct bcm_voter *voter)
 		return -ENODEV;
 
 	mutex_lock(&voter->lock);
+	stats = &voter->stats;
+
+	/* A queued AMC request failed, don't trust the recorded votes */
+	if (atomic_xchg(&voter->amc_failed, 0) && !++voter->gen)
+		voter->gen++;
 
-	list_for_each_entry(bcm, &voter->commit_list, list) {
+	list_for_each_entry_safe(bcm, bcm_tmp, &voter->commit_list, list) {
 		if (bcm->type == QCOM_ICC_BCM_TYPE_MASK || bcm->enable_mask)
 			bcm_aggregate_mask(bcm);
 		else
 			bcm_aggregate(bcm);
+
+		queued++;
+		if (bcm_vote_unchanged(voter, bcm))
+			list_del_init(&bcm->list);
+		else
+			sent++;
+	}
+
+	if (!queued)
+		goto out;
+
+	stats->bcms_skipped += queued - sent;
+	if (!sent) {
+		stats->skipped++;
+		goto out;
 	}
 
+	start = ktime_get();
+
 	if (voter->crm)
 		ret = commit_crm(voter);
 	else
 		ret = commit_rpmh(voter);
 
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+	stats->commits++;
+	stats->bcms_sent += sent;
+	stats->total_ns += elapsed;
+	stats->max_ns = max_t(u64, stats->max_ns, elapsed);
+
+	/*
+	 * The sent votes were recorded before the commit, so forget all of
+	 * them to make sure a vote that never reached hardware is not dropped.
+	 */
+	if (ret && !++voter->gen)
+		voter->gen++;
+
 	list_for_each_entry_safe(bcm, bcm_tmp, &voter->commit_list, list)
 		list_del_init(&bcm->list);
 
+out:
 	mutex_unlock(&voter->lock);
 	return ret;
 }
@@ -543,6 +680,7 @@ static int qcom_icc_bcm_voter_probe(struct platform_device *pdev)
 	voter->dev = &pdev->dev;
 	voter->np = np;
 	voter->has_amc = !of_property_read_bool(np, "qcom,no-amc");
+	voter->gen = 1;
 
 	if (of_property_read_u32(np, "qcom,tcs-wait", &voter->tcs_wait))
 		voter->tcs_wait = QCOM_ICC_TAG_ACTIVE_ONLY;
@@ -597,20 +735,57 @@ static int qcom_icc_bcm_voter_probe(struct platform_device *pdev)
 static int qcom_icc_bcm_voter_remove(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
-	struct bcm_voter *voter, *temp;
+	struct bcm_voter *voter, *temp, *found = NULL;
 
 	mutex_lock(&bcm_voter_lock);
 	list_for_each_entry_safe(voter, temp, &bcm_voters, voter_node) {
 		if (voter->np == np) {
 			list_del(&voter->voter_node);
+			found = voter;
 			break;
 		}
 	}
 	mutex_unlock(&bcm_voter_lock);
 
+	/* The queued AMC requests still reference the voter */
+	if (found)
+		wait_var_event(&found->amc_pending,
+			       !atomic_read(&found->amc_pending));
+
 	return 0;
 }
 
+static int bcm_voter_stats_show(struct seq_file *s, void *unused)
+{
+	struct bcm_voter_stats *stats;
+	struct bcm_voter *voter;
+	u64 avg_batch, avg_ns;
+
+	seq_printf(s, "%-24s %10s %10s %10s %10s %10s %10s %10s\n", "voter",
+		   "commits", "skipped", "bcms_sent", "bcms_skip", "avg_batch",
+		   "avg_ns", "max_ns");
+
+	mutex_lock(&bcm_voter_lock);
+	list_for_each_entry(voter, &bcm_voters, voter_node) {
+		mutex_lock(&voter->lock);
+		stats = &voter->stats;
+		avg_batch = stats->commits ?
+			    div64_u64(stats->bcms_sent, stats->commits) : 0;
+		avg_ns = stats->commits ?
+			 div64_u64(stats->total_ns, stats->commits) : 0;
+
+		seq_printf(s, "%-24s %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+			   voter->np->name, stats->commits, stats->skipped,
+			   stats->bcms_sent, stats->bcms_skipped, avg_batch,
+			   avg_ns, stats->max_ns);
+		mutex_unlock(&voter->lock);
+	}
+	mutex_unlock(&bcm_voter_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bcm_voter_stats);
+
 static const struct of_device_id bcm_voter_of_match[] = {
 	{ .compatible = "qcom,bcm-voter" },
 	{ }
@@ -628,7 +803,21 @@ static struct platform_driver qcom_icc_bcm_voter_driver = {
 
 static int __init qcom_icc_bcm_voter_driver_init(void)
 {
-	return platform_driver_register(&qcom_icc_bcm_voter_driver);
+	struct dentry *dir;
+	int ret;
+
+	ret = platform_driver_register(&qcom_icc_bcm_voter_driver);
+	if (ret)
+		return ret;
+
+	dir = debugfs_lookup("interconnect", NULL);
+	if (!IS_ERR_OR_NULL(dir)) {
+		debugfs_create_file("bcm_voter_stats", 0444, dir, NULL,
+				    &bcm_voter_stats_fops);
+		dput(dir);
+	}
+
+	return 0;
 }
 module_init(qcom_icc_bcm_voter_driver_init);
 
@@ -135,6 +135,8 @@ enum qcom_icc_bcm_type {
  * @vote_x: aggregated threshold values, represents sum_bw when @type is bw bcm
  * @vote_y: aggregated threshold values, represents peak_bw when @type is bw bcm
  * @vote_scale: scaling factor for vote_x and vote_y
+ * @sent_x: vote_x values last committed to hardware
+ * @sent_y: vote_y values last committed to hardware
  * @enable_mask: optional mask to send as vote instead of vote_x/vote_y
  * @perf_mode_mask: mask to OR with enable_mask when QCOM_ICC_TAG_PERF_MODE is set
  * @dirty: flag used to indicate whether the bcm needs to be committed
@@ -143,6 +145,7 @@ enum qcom_icc_bcm_type {
  * @qos_proxy: flag used to indicate whether a proxy vote needed as part of
  * qos configuration
  * @disabled: flag used to indicate state of bcm node
+ * @sent_gen: voter generation @sent_x and @sent_y are valid for
  * @aux_data: auxiliary data used when calculating threshold values and
  * communicating with RPMh
  * @list: used to link to other bcms when compiling lists for commit
@@ -157,6 +160,8 @@ struct qcom_icc_bcm {
 	u64 vote_x[QCOM_ICC_NUM_BUCKETS];
 	u64 vote_y[QCOM_ICC_NUM_BUCKETS];
 	u64 vote_scale;
+	u64 sent_x[QCOM_ICC_NUM_BUCKETS];
+	u64 sent_y[QCOM_ICC_NUM_BUCKETS];
 	u32 enable_mask;
 	u32 perf_mode_mask;
 	bool dirty;
@@ -164,6 +169,7 @@ struct qcom_icc_bcm {
 	bool keepalive_early;
 	bool qos_proxy;
 	bool disabled;
+	u32 sent_gen;
 	struct bcm_db aux_data;
 	struct list_head list;
 	struct list_head ws_list;
@@ -79,10 +79,20 @@
 struct md_stack_cpu_data {
 	int stack_mdidx[STACK_NUM_PAGES];
 	struct md_region stack_mdr[STACK_NUM_PAGES];
+	u64 lazy_sp;
 } ____cacheline_aligned_in_smp;
 
 static int md_current_stack_init __read_mostly;
 
+/*
+ * With stack_lazy set, context switches only record the stack of the next
+ * task and the minidump table is brought up to date from the panic
+ * notifier, instead of walking and updating every stack page on each
+ * switch. Resets which never reach panic will find stale stacks.
+ */
+static bool stack_lazy;
+module_param(stack_lazy, bool, 0644);
+
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct md_stack_cpu_data, md_stack_data);
 
 struct md_suspend_context_data {
@@ -299,28 +309,46 @@ void dump_stack_minidump(u64 sp)
 
 #ifdef CONFIG_QCOM_DYN_MINIDUMP_STACK
 static void update_stack_entry(struct md_region *ksp_entry, u64 sp,
-			       int mdno)
+			       struct page *sp_page, int mdno)
 {
-	struct page *sp_page;
+	u64 phys_addr;
 
-	ksp_entry->virt_addr = sp;
 	if (likely(is_vmap_stack)) {
-		sp_page = vmalloc_to_page((const void *) sp);
-		ksp_entry->phys_addr = page_to_phys(sp_page);
+		if (!sp_page)
+			sp_page = vmalloc_to_page((const void *) sp);
+		if (unlikely(!sp_page))
+			return;
+		phys_addr = page_to_phys(sp_page);
 	} else {
-		ksp_entry->phys_addr = virt_to_phys((uintptr_t *)sp);
+		phys_addr = virt_to_phys((uintptr_t *)sp);
 	}
+
+	/* Region still describes the same memory, skip the table update */
+	if (ksp_entry->virt_addr == sp && ksp_entry->phys_addr == phys_addr)
+		return;
+
+	ksp_entry->virt_addr = sp;
+	ksp_entry->phys_addr = phys_addr;
 	if (msm_minidump_update_region(mdno, ksp_entry) < 0) {
 		printk_deferred("Failed to update stack entry %s in minidump\n",
 			ksp_entry->name);
 	}
 }
 
+/*
+ * @vm, when known, provides the stack pages directly so that updates don't
+ * need to walk the page tables.
+ */
 static void register_vmapped_stack(struct md_region *mdr, int *mdno,
-				   u64 sp, char *name_str, bool update)
+				   u64 sp, struct vm_struct *vm,
+				   char *name_str, bool update)
 {
+	struct page *sp_page;
 	int i;
 
+	if (vm && (!vm->pages || vm->nr_pages < STACK_NUM_PAGES))
+		vm = NULL;
+
 	sp &= ~(PAGE_SIZE - 1);
 	for (i = 0; i < STACK_NUM_PAGES; i++) {
 		if (unlikely(!update)) {
@@ -328,7 +356,8 @@ static void register_vmapped_stack(struct md_region *mdr, int *mdno,
 					  name_str, i);
 			*mdno = register_stack_entry(mdr, sp, PAGE_SIZE);
 		} else {
-			update_stack_entry(mdr, sp, *mdno);
+			sp_page = vm ? vm->pages[i] : NULL;
+			update_stack_entry(mdr, sp, sp_page, *mdno);
 		}
 		sp += PAGE_SIZE;
 		mdr++;
@@ -344,12 +373,12 @@ static void register_normal_stack(struct md_region *mdr, int *mdno,
 		scnprintf(mdr->name, sizeof(mdr->name), name_str);
 		*mdno = register_stack_entry(mdr, sp, THREAD_SIZE);
 	} else {
-		update_stack_entry(mdr, sp, *mdno);
+		update_stack_entry(mdr, sp, NULL, *mdno);
 	}
 }
 
 static void update_md_stack(struct md_region *stack_mdr,
-			    int *stack_mdno, u64 sp)
+			    int *stack_mdno, u64 sp, struct vm_struct *vm)
 {
 	unsigned int i;
 	int *mdno;
@@ -360,7 +389,8 @@ static void update_md_stack(struct md_region *stack_mdr,
 			if (unlikely(*mdno < 0))
 				return;
 		}
-		register_vmapped_stack(stack_mdr, stack_mdno, sp, NULL, true);
+		register_vmapped_stack(stack_mdr, stack_mdno, sp, vm,
+				       NULL, true);
 	} else {
 		if (unlikely(*stack_mdno < 0))
 			return;
@@ -375,10 +405,47 @@ static void update_md_cpu_stack(struct task_struct *tsk, u32 cpu, u64 sp)
 	if (is_idle_task(tsk) || !md_current_stack_init)
 		return;
 
+	if (READ_ONCE(stack_lazy)) {
+		WRITE_ONCE(md_stack_cpu_d->lazy_sp, sp);
+		return;
+	}
+
 	update_md_stack(md_stack_cpu_d->stack_mdr,
-			md_stack_cpu_d->stack_mdidx, sp);
+			md_stack_cpu_d->stack_mdidx, sp,
+			task_stack_vm_area(tsk));
 }
 
+static int md_current_stack_panic_notify(struct notifier_block *nb,
+					 unsigned long event, void *ptr)
+{
+	struct md_stack_cpu_data *md_stack_cpu_d;
+	unsigned int cpu;
+	u64 sp;
+
+	if (!READ_ONCE(stack_lazy))
+		return NOTIFY_DONE;
+
+	/*
+	 * The recorded stacks may belong to tasks which exited since, the
+	 * page table walk will skip the pages which are no longer mapped.
+	 */
+	for_each_possible_cpu(cpu) {
+		md_stack_cpu_d = &per_cpu(md_stack_data, cpu);
+		sp = READ_ONCE(md_stack_cpu_d->lazy_sp);
+		if (!sp)
+			continue;
+		update_md_stack(md_stack_cpu_d->stack_mdr,
+				md_stack_cpu_d->stack_mdidx, sp, NULL);
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block md_current_stack_panic_nb = {
+	.notifier_call = md_current_stack_panic_notify,
+	.priority = INT_MAX - 3, /* < msm watchdog panic notifier */
+};
+
 void md_current_stack_notifer(void *ignore, bool preempt,
 		struct task_struct *prev, struct task_struct *next,
 		unsigned int prev_state)
@@ -416,14 +483,14 @@ static void update_md_current_task(struct md_region *mdr, int mdno)
 static void update_md_suspend_current_stack(void)
 {
 	u64 sp = current_stack_pointer;
-	struct vm_struct *stack_vm_area;
+	struct vm_struct *stack_vm_area = NULL;
 
 	if (likely(is_vmap_stack)) {
 		stack_vm_area = task_stack_vm_area(current);
 		sp = (u64)stack_vm_area->addr;
 	}
 	update_md_stack(md_suspend_context.stack_mdr,
-			md_suspend_context.stack_mdidx, sp);
+			md_suspend_context.stack_mdidx, sp, stack_vm_area);
 }
 
 static void update_md_suspend_current_task(void)
@@ -471,7 +538,7 @@ static void register_current_stack(void)
 		scnprintf(name_str, sizeof(name_str), "KSTACK%d", cpu);
 		if (is_vmap_stack)
 			register_vmapped_stack(md_stack_cpu_d->stack_mdr,
-				md_stack_cpu_d->stack_mdidx, sp,
+				md_stack_cpu_d->stack_mdidx, sp, NULL,
 				name_str, false);
 		else
 			register_normal_stack(md_stack_cpu_d->stack_mdr,
@@ -480,6 +547,8 @@ static void register_current_stack(void)
 	}
 
 	register_trace_sched_switch(md_current_stack_notifer, NULL);
+	atomic_notifier_chain_register(&panic_notifier_list,
+				       &md_current_stack_panic_nb);
 	md_current_stack_init = 1;
 	smp_call_function(md_current_stack_ipi_handler, NULL, 1);
 }
@@ -495,7 +564,7 @@ static void register_suspend_stack(void)
 		sp = (u64)stack_vm_area->addr;
 		register_vmapped_stack(md_suspend_context.stack_mdr,
 				md_suspend_context.stack_mdidx,
-				sp, name_str, false);
+				sp, NULL, name_str, false);
 	} else {
 		register_normal_stack(md_suspend_context.stack_mdr,
 			md_suspend_context.stack_mdidx,
@@ -18,6 +18,10 @@
 #include <linux/elf.h>
 #include <linux/slab.h>
 #include <linux/panic_notifier.h>
+#include <linux/lz4.h>
+#include <linux/sched/clock.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
 #include <soc/qcom/minidump.h>
 #include "elf.h"
 
@@ -39,6 +43,33 @@ struct va_md_elf_info {
 #define VA_MD_CB_MARKER		-2
 #define MAX_ELF_SECTION		0xFFFFU
 
+#ifndef SHF_COMPRESSED
+#define SHF_COMPRESSED		0x800
+#endif
+
+/*
+ * Sections flagged SHF_COMPRESSED start with this header, laid out as
+ * Elf64_Chdr, followed by the LZ4 compressed region. ch_type uses the OS
+ * specific range since ELF has no LZ4 compression type.
+ */
+struct va_md_chdr {
+	u32 ch_type;
+	u32 ch_reserved;
+	u64 ch_size;
+	u64 ch_addralign;
+};
+
+#define VA_MD_ELFCOMPRESS_LZ4	0x60000001
+
+/*
+ * Program header type of a compressed region. A PT_LOAD with p_filesz
+ * smaller than p_memsz means zero filled memory, so compressed regions
+ * use an OS specific type ("LZ4") that loaders ignore. p_memsz still
+ * holds the size of the region once decompressed.
+ */
+#define VA_MD_PT_LZ4		(PT_LOOS + 0x4c5a34)
+#define VA_MD_SCRATCH_SIZE	SZ_256K
+
 struct va_minidump_data {
 	phys_addr_t mem_phys_addr;
 	unsigned int total_mem_size;
@@ -47,6 +78,9 @@ struct va_minidump_data {
 	unsigned long str_tbl_idx;
 	struct va_md_elf_info elf;
 	struct md_region md_entry;
+	int md_idx;
+	void *lz4_wrkmem;
+	void *lz4_scratch;
 	bool in_oops_handler;
 	bool va_md_minidump_reg;
 	bool va_md_init;
@@ -477,7 +511,8 @@ static void qcom_va_md_minidump_registration(void)
 		va_md_data.elf.pload_size + va_md_data.elf.str_tbl_size;
 	va_md_data.md_entry.size = ALIGN(va_md_data.md_entry.size, 4);
 
-	if (msm_minidump_add_region(&va_md_data.md_entry) < 0) {
+	va_md_data.md_idx = msm_minidump_add_region(&va_md_data.md_entry);
+	if (va_md_data.md_idx < 0) {
 		pr_err("Failed to register VA driver CMA region with minidump\n");
 		va_md_data.va_md_minidump_reg = false;
 		return;
@@ -524,11 +559,111 @@ static void qcom_va_add_elf_hdr(void)
 	ehdr->e_phoff = phdr_off;
 }
 
+#if IS_ENABLED(CONFIG_QCOM_VA_MINIDUMP_COMPRESS)
+static bool compress = true;
+module_param(compress, bool, 0644);
+
+static unsigned long qcom_va_md_compress(void *dst, const void *src,
+					 unsigned long size)
+{
+	struct va_md_chdr *chdr = dst;
+	int len;
+
+	if (size <= sizeof(*chdr) || size > LZ4_MAX_INPUT_SIZE)
+		return 0;
+
+	/* only keep the compressed form when it is strictly smaller */
+	len = LZ4_compress_default(src, (char *)(chdr + 1), size,
+				   size - sizeof(*chdr) - 1, va_md_data.lz4_wrkmem);
+	if (len <= 0)
+		return 0;
+
+	chdr->ch_type = VA_MD_ELFCOMPRESS_LZ4;
+	chdr->ch_reserved = 0;
+	chdr->ch_size = size;
+	chdr->ch_addralign = 1;
+
+	return sizeof(*chdr) + len;
+}
+
+/*
+ * Stores a region at @dst, LZ4 compressed when that makes it smaller, and
+ * sets @compressed accordingly. Returns the number of bytes used at @dst.
+ */
+static unsigned long qcom_va_md_store(struct va_md_entry *entry, void *dst,
+				      bool *compressed)
+{
+	void *src = (void *)entry->vaddr;
+	unsigned long len;
+
+	*compressed = false;
+	if (!READ_ONCE(compress) || !va_md_data.lz4_wrkmem)
+		goto raw;
+
+	if (!src) {
+		if (!va_md_data.lz4_scratch ||
+		    entry->size > VA_MD_SCRATCH_SIZE)
+			goto raw;
+		src = va_md_data.lz4_scratch;
+		entry->cb(src, entry->size);
+	}
+
+	len = qcom_va_md_compress(dst, src, entry->size);
+	if (len) {
+		*compressed = true;
+		return len;
+	}
+
+	memcpy(dst, src, entry->size);
+	return entry->size;
+raw:
+	if (src)
+		memcpy(dst, src, entry->size);
+	else
+		entry->cb(dst, entry->size);
+	return entry->size;
+}
+
+static void qcom_va_md_compress_init(void)
+{
+	va_md_data.lz4_wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	va_md_data.lz4_scratch = vmalloc(VA_MD_SCRATCH_SIZE);
+	if (!va_md_data.lz4_wrkmem)
+		pr_err("Failed to allocate LZ4 work memory, not compressing\n");
+}
+
+static void qcom_va_md_compress_exit(void)
+{
+	vfree(va_md_data.lz4_wrkmem);
+	vfree(va_md_data.lz4_scratch);
+	va_md_data.lz4_wrkmem = NULL;
+	va_md_data.lz4_scratch = NULL;
+}
+#else
+static unsigned long qcom_va_md_store(struct va_md_entry *entry, void *dst,
+				      bool *compressed)
+{
+	*compressed = false;
+	if (entry->vaddr)
+		memcpy(dst, (void *)entry->vaddr, entry->size);
+	else
+		entry->cb(dst, entry->size);
+	return entry->size;
+}
+
+static inline void qcom_va_md_compress_init(void) {}
+static inline void qcom_va_md_compress_exit(void) {}
+#endif
+
 static void qcom_va_add_hdrs(void)
 {
 	struct elf_shdr *shdr;
 	struct elf_phdr *phdr;
-	unsigned long strtbl_off, offset, i;
+	unsigned long strtbl_off, offset, i, len;
+	unsigned long raw_size = 0;
+	u64 t_start = local_clock();
+	bool compressed;
+	void *dst;
 	struct elfhdr *ehdr = (struct elfhdr *)va_md_data.elf.ehdr;
 	struct va_md_tree_node *arr = (struct va_md_tree_node *)va_md_data.elf_mem;
 
@@ -565,20 +700,36 @@ static void qcom_va_add_hdrs(void)
 		phdr->p_filesz = phdr->p_memsz = arr[i].entry.size;
 		phdr->p_flags = PF_R | PF_W;
 
-		if (arr[i].entry.vaddr) {
+		dst = (void *)(va_md_data.elf.ehdr + offset);
+		if (arr[i].entry.vaddr)
 			shdr->sh_addr =  phdr->p_vaddr = arr[i].entry.vaddr;
-			memcpy((void *)(va_md_data.elf.ehdr + offset),
-				(void *)shdr->sh_addr, shdr->sh_size);
-		} else {
-			shdr->sh_addr =  phdr->p_vaddr = va_md_data.elf.ehdr + offset;
-			arr[i].entry.cb((void *)(va_md_data.elf.ehdr + offset),
-				shdr->sh_size);
+		else
+			shdr->sh_addr =  phdr->p_vaddr = (unsigned long)dst;
+
+		/* p_memsz keeps the size of the region once decompressed */
+		len = qcom_va_md_store(&arr[i].entry, dst, &compressed);
+		if (compressed) {
+			shdr->sh_flags |= SHF_COMPRESSED;
+			shdr->sh_size = phdr->p_filesz = len;
+			phdr->p_type = VA_MD_PT_LZ4;
 		}
 
+		raw_size += arr[i].entry.size;
 		offset += shdr->sh_size;
 		ehdr->e_shnum++;
 		ehdr->e_phnum++;
 	}
+
+	/* Payload comes last, only collect what compression left of it */
+	if (offset - strtbl_off - va_md_data.elf.str_tbl_size < raw_size) {
+		va_md_data.md_entry.size = ALIGN(offset, 4);
+		if (msm_minidump_update_region(va_md_data.md_idx,
+					       &va_md_data.md_entry) < 0)
+			pr_err("Failed to shrink VA minidump region\n");
+		pr_info("Compressed %lu bytes to %lu in %llu us\n", raw_size,
+			offset - strtbl_off - va_md_data.elf.str_tbl_size,
+			div_u64(local_clock() - t_start, NSEC_PER_USEC));
+	}
 }
 
 static int qcom_va_md_calc_size(unsigned int shdr_cnt)
@@ -759,6 +910,7 @@ static int qcom_va_md_driver_remove(struct platform_device *pdev)
 	kset_unregister(va_md_data.va_md_kset);
 	atomic_notifier_chain_unregister(&panic_notifier_list, &qcom_va_md_elf_panic_blk);
 	atomic_notifier_chain_unregister(&panic_notifier_list, &qcom_va_md_panic_blk);
+	qcom_va_md_compress_exit();
 	vunmap((void *)va_md_data.elf_mem);
 	return 0;
 }
@@ -804,6 +956,7 @@ static int qcom_va_md_driver_probe(struct platform_device *pdev)
 
 	va_md_data.mem_phys_addr = dma_to_phys(&pdev->dev, dma_handle);
 	va_md_data.elf_mem = (unsigned long)vaddr;
+	qcom_va_md_compress_init();
 
 	atomic_notifier_chain_register(&panic_notifier_list, &qcom_va_md_panic_blk);
 	atomic_notifier_chain_register(&panic_notifier_list, &qcom_va_md_elf_panic_blk);
@@ -812,6 +965,7 @@ static int qcom_va_md_driver_probe(struct platform_device *pdev)
 	va_md_data.va_md_kset = kset_create_and_add("va-minidump", NULL, kernel_kobj);
 	if (!va_md_data.va_md_kset) {
 		dev_err(&pdev->dev, "Failed to create kset for va-minidump\n");
+		qcom_va_md_compress_exit();
 		vunmap((void *)va_md_data.elf_mem);
 		ret = -ENOMEM;
 		goto out;
@@ -10,6 +10,7 @@
 
 #include <linux/bitmap.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <soc/qcom/tcs.h>
 
 #define MAX_NAME_LENGTH			20
@@ -86,15 +87,41 @@ struct tcs_group {
  * @msg: the request
  * @cmd: the payload that will be part of the @msg
  * @completion: triggered when request is done
+ * @tx_done: called with the result instead of triggering @completion when
+ *           request is done
  * @dev: the device making the request
  */
 struct rpmh_request {
 	struct tcs_request msg;
 	struct tcs_cmd cmd[MAX_RPMH_PAYLOAD];
 	struct completion *completion;
+	void (*tx_done)(struct rpmh_request *rpm_msg, int err);
 	const struct device *dev;
 };
 
+/**
+ * struct rpmh_queue_stats: statistics of the queued request submission
+ *
+ * @submitted: requests submitted with rpmh_write_queued()
+ * @completed: requests completed, including the failed ones
+ * @errors: requests completed with an error
+ * @batches: TCS transfers used to send the submitted requests
+ * @depth: requests waiting to be sent to the controller
+ * @max_depth: highest @depth seen
+ * @total_ns: total time from submission to completion
+ * @max_ns: longest time from submission to completion
+ */
+struct rpmh_queue_stats {
+	u64 submitted;
+	u64 completed;
+	u64 errors;
+	u64 batches;
+	u32 depth;
+	u32 max_depth;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 /**
  * struct rpmh_ctrlr: our representation of the controller
  *
@@ -103,6 +130,13 @@ struct rpmh_request {
  * @in_solver_mode: Controller is busy in solver mode
  * @flags: Controller specific flags
  * @batch_cache: Cache sleep and wake requests sent as batch
+ * @queue_lock: synchronize access to @queue and @queue_stats
+ * @queue: requests from rpmh_write_queued() waiting to be sent
+ * @queue_work: work sending the requests in @queue to the controller
+ * @queue_inflight: queued requests sent to the controller, oldest first
+ * @queue_timeout_work: work failing the requests in @queue_inflight that
+ *                      take longer than RPMH_TIMEOUT_MS to complete
+ * @queue_stats: statistics of the queued requests
  */
 struct rpmh_ctrlr {
 	spinlock_t cache_lock;
@@ -112,6 +146,12 @@ struct rpmh_ctrlr {
 	struct rpmh_request batch_cache[RPMH_ACTIVE_ONLY_STATE];
 	u32 non_batch_cache_idx;
 	struct cache_req *non_batch_cache;
+	spinlock_t queue_lock;
+	struct list_head queue;
+	struct work_struct queue_work;
+	struct list_head queue_inflight;
+	struct delayed_work queue_timeout_work;
+	struct rpmh_queue_stats queue_stats;
 };
 
 struct rsc_ver {
@@ -229,7 +269,9 @@ int rpmh_rsc_switch_channel(struct rsc_drv *drv, int ch);
 int rpmh_rsc_drv_enable(struct rsc_drv *drv, bool enable);
 const struct device *rpmh_rsc_get_device(const char *name, u32 drv_id);
 
-void rpmh_tx_done(const struct tcs_request *msg);
+void rpmh_tx_done(const struct tcs_request *msg, int err);
+int rpmh_queue_init(struct device *dev, struct rpmh_ctrlr *ctrlr);
+void rpmh_queue_debugfs_init(struct device *dev, struct rpmh_ctrlr *ctrlr);
 int rpmh_flush(struct rpmh_ctrlr *ctrlr, int ch);
 int _rpmh_flush(struct rpmh_ctrlr *ctrlr, int ch);
 
@@ -552,6 +552,37 @@ static void enable_tcs_irq(struct rsc_drv *drv, int tcs_id, bool enable)
 	writel_relaxed(data, drv->tcs_base + reg);
 }
 
+/**
+ * tcs_req_status() - Check that all the commands of a request completed.
+ * @drv:    The controller.
+ * @tcs_id: The TCS the request was sent with.
+ * @req:    The request.
+ *
+ * Return: 0 if every command was issued, and completed when it had to be,
+ *         or -EIO otherwise.
+ */
+static int tcs_req_status(struct rsc_drv *drv, int tcs_id,
+			  const struct tcs_request *req)
+{
+	const struct tcs_cmd *cmd;
+	u32 sts;
+	int j;
+
+	for (j = 0; j < req->num_cmds; j++) {
+		cmd = &req->cmds[j];
+		sts = read_tcs_cmd(drv, drv->regs[RSC_DRV_CMD_STATUS], tcs_id, j);
+		if (!(sts & CMD_STATUS_ISSUED) ||
+		    ((req->wait_for_compl || cmd->wait) &&
+		     !(sts & CMD_STATUS_COMPL))) {
+			pr_err("Incomplete request: %s: addr=%#x data=%#x\n",
+			       drv->name, cmd->addr, cmd->data);
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * tcs_tx_done() - TX Done interrupt handler.
  * @irq: The IRQ number (ignored).
@@ -565,7 +596,7 @@ static void enable_tcs_irq(struct rsc_drv *drv, int tcs_id, bool enable)
 static irqreturn_t tcs_tx_done(int irq, void *p)
 {
 	struct rsc_drv *drv = p;
-	int i, ch;
+	int i, ch, err = 0;
 	unsigned long irq_status;
 	const struct tcs_request *req;
 
@@ -576,6 +607,7 @@ static irqreturn_t tcs_tx_done(int irq, void *p)
 		if (WARN_ON(!req))
 			goto skip;
 
+		err = tcs_req_status(drv, i, req);
 		trace_rpmh_tx_done(drv, i, req);
 #if IS_ENABLED(CONFIG_IPC_LOGGING)
 		ipc_log_string(drv->ipc_log_ctx, "IRQ response: m=%d", i);
@@ -605,7 +637,7 @@ static irqreturn_t tcs_tx_done(int irq, void *p)
 		spin_unlock(&drv->lock);
 		wake_up(&drv->tcs_wait);
 		if (req)
-			rpmh_tx_done(req);
+			rpmh_tx_done(req, err);
 	}
 
 	return IRQ_HANDLED;
@@ -808,6 +840,11 @@ int rpmh_rsc_send_data(struct rsc_drv *drv, const struct tcs_request *msg, int c
 	struct tcs_group *tcs;
 	int tcs_id;
 	unsigned long flags;
+	/*
+	 * Once triggered, the completion may free @msg (see
+	 * rpmh_write_queued()), so don't look at it past the trigger.
+	 */
+	bool wait_for_compl = msg->wait_for_compl;
 
 	tcs = get_tcs_for_msg(drv, msg->state, ch);
 	if (IS_ERR(tcs))
@@ -837,7 +874,7 @@ int rpmh_rsc_send_data(struct rsc_drv *drv, const struct tcs_request *msg, int c
 	write_tcs_reg_sync(drv, drv->regs[RSC_DRV_CMD_ENABLE], tcs_id, 0);
 	write_tcs_reg_sync(drv, drv->regs[RSC_DRV_CMD_WAIT_FOR_CMPL], tcs_id, 0);
 
-	if (msg->wait_for_compl || (msg->state == RPMH_ACTIVE_ONLY_STATE &&
+	if (wait_for_compl || (msg->state == RPMH_ACTIVE_ONLY_STATE &&
 	    tcs->type != ACTIVE_TCS))
 		enable_tcs_irq(drv, tcs_id, true);
 	else
@@ -855,14 +892,14 @@ int rpmh_rsc_send_data(struct rsc_drv *drv, const struct tcs_request *msg, int c
 	__tcs_set_trigger(drv, tcs_id, true);
 #if IS_ENABLED(CONFIG_IPC_LOGGING)
 	ipc_log_string(drv->ipc_log_ctx, "TCS trigger: m=%d wait_for_compl=%u",
-		       tcs_id, msg->wait_for_compl);
+		       tcs_id, wait_for_compl);
 #endif
-	if (!msg->wait_for_compl)
+	if (!wait_for_compl)
 		clear_bit(tcs_id, drv->tcs_in_use);
 
 	spin_unlock_irqrestore(&drv->lock, flags);
 
-	if (!msg->wait_for_compl)
+	if (!wait_for_compl)
 		wake_up(&drv->tcs_wait);
 
 	return 0;
@@ -1873,6 +1910,10 @@ static int rpmh_rsc_probe(struct platform_device *pdev)
 		for (j = 0; j < CMD_DB_MAX_RESOURCES; j++)
 			INIT_LIST_HEAD(&drv[i].client.non_batch_cache[j].list);
 
+		ret = rpmh_queue_init(&pdev->dev, &drv[i].client);
+		if (ret)
+			return ret;
+
 		irq = platform_get_irq(pdev, drv[i].id);
 		if (irq < 0)
 			return irq;
@@ -1903,7 +1944,16 @@ static int rpmh_rsc_probe(struct platform_device *pdev)
 	list_add_tail(&rsc_top->list, &rpmh_rsc_dev_list);
 	dev_set_drvdata(&pdev->dev, rsc_top);
 
-	return devm_of_platform_populate(&pdev->dev);
+	ret = devm_of_platform_populate(&pdev->dev);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < drv_count; i++) {
+		if (drv[i].initialized)
+			rpmh_queue_debugfs_init(&pdev->dev, &drv[i].client);
+	}
+
+	return 0;
 }
 
 static const struct dev_pm_ops rpmh_rsc_dev_pm_ops = {
@@ -6,14 +6,18 @@
 
 #include <linux/atomic.h>
 #include <linux/bug.h>
+#include <linux/debugfs.h>
 #include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/lockdep.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/refcount.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
@@ -40,6 +44,38 @@
 
 #define ctrlr_to_drv(ctrlr) container_of(ctrlr, struct rsc_drv, client)
 
+/**
+ * struct rpmh_queued_req: a request submitted with rpmh_write_queued()
+ *
+ * @rpm_msg: the message; holds the commands of the whole batch when this
+ *           request leads it
+ * @list: link in the controller queue, in the batch of the leader, or in
+ *        the in-flight list of the controller once a leader is sent
+ * @batch: requests merged into this one when it leads a batch
+ * @ctrlr: the controller the request is sent to
+ * @done: client callback called when the request is complete
+ * @data: client data passed to @done
+ * @queued: time the request was submitted
+ * @sent: jiffies when the leader was handed to the controller
+ * @ref: held by the TCS transfer and by the completion of the batch, which
+ *       the timeout can take over from the transfer
+ * @expired: the batch of this leader was completed by the timeout
+ */
+struct rpmh_queued_req {
+	struct rpmh_request rpm_msg;
+	struct list_head list;
+	struct list_head batch;
+	struct rpmh_ctrlr *ctrlr;
+	void (*done)(void *data, int err);
+	void *data;
+	ktime_t queued;
+	unsigned long sent;
+	refcount_t ref;
+	bool expired;
+};
+
+static struct dentry *rpmh_debugfs_dir;
+
 static struct rpmh_ctrlr *get_rpmh_ctrlr(const struct device *dev)
 {
 	struct rsc_drv *drv = dev_get_drvdata(dev->parent);
@@ -73,12 +109,17 @@ static int check_ctrlr_state(struct rpmh_ctrlr *ctrlr, enum rpmh_state state)
 	return ret;
 }
 
-void rpmh_tx_done(const struct tcs_request *msg)
+void rpmh_tx_done(const struct tcs_request *msg, int err)
 {
 	struct rpmh_request *rpm_msg = container_of(msg, struct rpmh_request,
 						    msg);
 	struct completion *compl = rpm_msg->completion;
 
+	if (rpm_msg->tx_done) {
+		rpm_msg->tx_done(rpm_msg, err);
+		return;
+	}
+
 	if (!compl)
 		return;
 
@@ -185,7 +226,7 @@ static int __rpmh_write(const struct device *dev, enum rpmh_state state,
 	} else {
 		/* Clean up our call by spoofing tx_done */
 		ret = 0;
-		rpmh_tx_done(&rpm_msg->msg);
+		rpmh_tx_done(&rpm_msg->msg, 0);
 	}
 
 	return ret;
@@ -370,6 +411,348 @@ int rpmh_write_batch(const struct device *dev, enum rpmh_state state,
 }
 EXPORT_SYMBOL(rpmh_write_batch);
 
+static void rpmh_queue_finish(struct rpmh_ctrlr *ctrlr,
+			      struct rpmh_queued_req *req, ktime_t now, int err)
+{
+	struct rpmh_queue_stats *stats = &ctrlr->queue_stats;
+	u64 ns = ktime_to_ns(ktime_sub(now, req->queued));
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	stats->completed++;
+	if (err)
+		stats->errors++;
+	stats->total_ns += ns;
+	stats->max_ns = max(stats->max_ns, ns);
+	spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+
+	if (req->done)
+		req->done(req->data, err);
+}
+
+/* Completes the batch of @lead, and frees all of it but @lead */
+static void rpmh_queue_complete(struct rpmh_queued_req *lead, int err)
+{
+	struct rpmh_ctrlr *ctrlr = lead->ctrlr;
+	struct rpmh_queued_req *req, *tmp;
+	ktime_t now = ktime_get();
+
+	list_for_each_entry_safe(req, tmp, &lead->batch, list) {
+		rpmh_queue_finish(ctrlr, req, now, err);
+		kfree(req);
+	}
+
+	rpmh_queue_finish(ctrlr, lead, now, err);
+}
+
+/*
+ * Called once the controller is done with @lead, or failed to take it.
+ * Unless the timeout already completed the batch, complete it with @err.
+ */
+static void rpmh_queue_done(struct rpmh_queued_req *lead, int err)
+{
+	struct rpmh_ctrlr *ctrlr = lead->ctrlr;
+	unsigned long flags;
+	bool expired;
+
+	spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	expired = lead->expired;
+	if (!expired)
+		list_del(&lead->list);
+	spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+
+	if (!expired)
+		rpmh_queue_complete(lead, err);
+
+	if (refcount_sub_and_test(expired ? 1 : 2, &lead->ref))
+		kfree(lead);
+}
+
+static void rpmh_queue_tx_done(struct rpmh_request *rpm_msg, int err)
+{
+	rpmh_queue_done(container_of(rpm_msg, struct rpmh_queued_req, rpm_msg),
+			err);
+}
+
+/*
+ * Fail the batches the controller didn't complete in time. A leader stays
+ * allocated until the controller is done with it, since its message is
+ * still referenced by the TCS.
+ */
+static void rpmh_queue_timeout_work(struct work_struct *work)
+{
+	struct rpmh_ctrlr *ctrlr = container_of(to_delayed_work(work),
+						struct rpmh_ctrlr,
+						queue_timeout_work);
+	struct rpmh_queued_req *lead;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	while (!list_empty(&ctrlr->queue_inflight)) {
+		lead = list_first_entry(&ctrlr->queue_inflight,
+					struct rpmh_queued_req, list);
+		if (time_before(jiffies, lead->sent + RPMH_TIMEOUT_MS)) {
+			queue_delayed_work(system_highpri_wq,
+					   &ctrlr->queue_timeout_work,
+					   lead->sent + RPMH_TIMEOUT_MS - jiffies);
+			break;
+		}
+
+		list_del(&lead->list);
+		lead->expired = true;
+		spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+
+		pr_err("Queued RPMH message addr=%#x timed out\n",
+		       lead->rpm_msg.msg.cmds[0].addr);
+		rpmh_queue_complete(lead, -ETIMEDOUT);
+		if (refcount_dec_and_test(&lead->ref))
+			kfree(lead);
+
+		spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	}
+	spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+}
+
+/*
+ * Requests can share a TCS as long as the commands fit and no resource is
+ * voted twice, so the order of the votes to each resource is kept.
+ */
+static bool rpmh_queue_can_merge(const struct rpmh_queued_req *lead,
+				 const struct rpmh_queued_req *req)
+{
+	const struct tcs_request *a = &lead->rpm_msg.msg;
+	const struct tcs_request *b = &req->rpm_msg.msg;
+	int i, j;
+
+	if (a->num_cmds + b->num_cmds > MAX_RPMH_PAYLOAD)
+		return false;
+
+	for (i = 0; i < a->num_cmds; i++)
+		for (j = 0; j < b->num_cmds; j++)
+			if (a->cmds[i].addr == b->cmds[j].addr)
+				return false;
+
+	return true;
+}
+
+static void rpmh_queue_work(struct work_struct *work)
+{
+	struct rpmh_ctrlr *ctrlr = container_of(work, struct rpmh_ctrlr,
+						queue_work);
+	struct rsc_drv *drv = ctrlr_to_drv(ctrlr);
+	struct rpmh_queued_req *lead, *req, *tmp;
+	struct tcs_request *msg;
+	unsigned long flags;
+	int ret, ch;
+
+	spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	while (!list_empty(&ctrlr->queue)) {
+		lead = list_first_entry(&ctrlr->queue, struct rpmh_queued_req,
+					list);
+		list_del(&lead->list);
+		ctrlr->queue_stats.depth--;
+		msg = &lead->rpm_msg.msg;
+
+		/* Merge the requests that follow in order until one doesn't fit */
+		list_for_each_entry_safe(req, tmp, &ctrlr->queue, list) {
+			if (!rpmh_queue_can_merge(lead, req))
+				break;
+
+			memcpy(&lead->rpm_msg.cmd[msg->num_cmds], req->rpm_msg.cmd,
+			       req->rpm_msg.msg.num_cmds * sizeof(*req->rpm_msg.cmd));
+			msg->num_cmds += req->rpm_msg.msg.num_cmds;
+			list_move_tail(&req->list, &lead->batch);
+			ctrlr->queue_stats.depth--;
+		}
+		ctrlr->queue_stats.batches++;
+
+		/* The timeout also covers the wait for a free TCS */
+		refcount_set(&lead->ref, 2);
+		lead->sent = jiffies;
+		list_add_tail(&lead->list, &ctrlr->queue_inflight);
+		spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+
+		queue_delayed_work(system_highpri_wq, &ctrlr->queue_timeout_work,
+				   RPMH_TIMEOUT_MS);
+
+		ret = check_ctrlr_state(ctrlr, RPMH_ACTIVE_ONLY_STATE);
+		if (!ret) {
+			ch = rpmh_rsc_get_channel(drv);
+			ret = ch < 0 ? ch : rpmh_rsc_send_data(drv, msg, ch);
+		}
+		if (ret) {
+			pr_err("Error(%d) sending queued RPMH message addr=%#x\n",
+			       ret, msg->cmds[0].addr);
+			rpmh_queue_done(lead, ret);
+		}
+
+		spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	}
+	spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+}
+
+/**
+ * rpmh_write_queued: Queue a set of active RPMH commands
+ *
+ * @dev: The device making the request
+ * @cmd: The payload data
+ * @n: The number of elements in @cmd
+ * @done: Callback called with @data and the result once the request is
+ *        complete, may be NULL
+ * @data: Client data passed to @done
+ *
+ * Cache the RPMH request and queue it to be sent as an ACTIVE_ONLY request
+ * without waiting for a free TCS. Queued requests are sent in order, and
+ * consecutive requests voting on different resources are merged into a
+ * single TCS transfer. @done is called from the TCS completion interrupt
+ * with the status of the transfer, from the sending work if the request
+ * could not be sent, or with -ETIMEDOUT if it did not complete within
+ * RPMH_TIMEOUT_MS of being sent. It must not sleep.
+ *
+ * Does not sleep.
+ */
+int rpmh_write_queued(const struct device *dev, const struct tcs_cmd *cmd,
+		      u32 n, void (*done)(void *data, int err), void *data)
+{
+	struct rpmh_ctrlr *ctrlr = get_rpmh_ctrlr(dev);
+	struct rpmh_queue_stats *stats = &ctrlr->queue_stats;
+	struct rpmh_queued_req *req;
+	struct cache_req *cache;
+	unsigned long flags;
+	int ret, i;
+
+	if (rpmh_standalone) {
+		if (done)
+			done(data, 0);
+		return 0;
+	}
+
+	ret = check_ctrlr_state(ctrlr, RPMH_ACTIVE_ONLY_STATE);
+	if (ret)
+		return ret;
+
+	req = kzalloc(sizeof(*req), GFP_ATOMIC);
+	if (!req)
+		return -ENOMEM;
+
+	ret = __fill_rpmh_msg(&req->rpm_msg, RPMH_ACTIVE_ONLY_STATE, cmd, n);
+	if (ret)
+		goto err;
+
+	for (i = 0; i < n; i++) {
+		cache = cache_rpm_request(ctrlr, RPMH_ACTIVE_ONLY_STATE,
+					  &req->rpm_msg.cmd[i]);
+		if (IS_ERR(cache)) {
+			ret = PTR_ERR(cache);
+			goto err;
+		}
+	}
+
+	req->rpm_msg.msg.wait_for_compl = true;
+	req->rpm_msg.tx_done = rpmh_queue_tx_done;
+	req->rpm_msg.dev = dev;
+	INIT_LIST_HEAD(&req->batch);
+	req->ctrlr = ctrlr;
+	req->done = done;
+	req->data = data;
+	req->queued = ktime_get();
+
+	spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	list_add_tail(&req->list, &ctrlr->queue);
+	stats->submitted++;
+	stats->depth++;
+	stats->max_depth = max(stats->max_depth, stats->depth);
+	spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+
+	queue_work(system_highpri_wq, &ctrlr->queue_work);
+
+	return 0;
+
+err:
+	kfree(req);
+	return ret;
+}
+EXPORT_SYMBOL(rpmh_write_queued);
+
+static int rpmh_queue_stats_show(struct seq_file *s, void *unused)
+{
+	struct rpmh_ctrlr *ctrlr = s->private;
+	struct rpmh_queue_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctrlr->queue_lock, flags);
+	stats = ctrlr->queue_stats;
+	spin_unlock_irqrestore(&ctrlr->queue_lock, flags);
+
+	seq_printf(s, "submitted: %llu\n", stats.submitted);
+	seq_printf(s, "completed: %llu\n", stats.completed);
+	seq_printf(s, "errors: %llu\n", stats.errors);
+	seq_printf(s, "batches: %llu\n", stats.batches);
+	seq_printf(s, "avg_batch: %llu\n", stats.batches ?
+		   div64_u64(stats.submitted - stats.depth, stats.batches) : 0);
+	seq_printf(s, "depth: %u\n", stats.depth);
+	seq_printf(s, "max_depth: %u\n", stats.max_depth);
+	seq_printf(s, "avg_latency_ns: %llu\n", stats.completed ?
+		   div64_u64(stats.total_ns, stats.completed) : 0);
+	seq_printf(s, "max_latency_ns: %llu\n", stats.max_ns);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rpmh_queue_stats);
+
+static void rpmh_queue_exit(void *data)
+{
+	struct rpmh_ctrlr *ctrlr = data;
+
+	cancel_work_sync(&ctrlr->queue_work);
+	cancel_delayed_work_sync(&ctrlr->queue_timeout_work);
+}
+
+/**
+ * rpmh_queue_init: Initialize the queued request submission of a controller
+ *
+ * @dev: The device of the controller, the works are stopped when it unbinds
+ * @ctrlr: The controller
+ */
+int rpmh_queue_init(struct device *dev, struct rpmh_ctrlr *ctrlr)
+{
+	spin_lock_init(&ctrlr->queue_lock);
+	INIT_LIST_HEAD(&ctrlr->queue);
+	INIT_LIST_HEAD(&ctrlr->queue_inflight);
+	INIT_WORK(&ctrlr->queue_work, rpmh_queue_work);
+	INIT_DELAYED_WORK(&ctrlr->queue_timeout_work, rpmh_queue_timeout_work);
+
+	return devm_add_action_or_reset(dev, rpmh_queue_exit, ctrlr);
+}
+
+static void rpmh_queue_debugfs_exit(void *data)
+{
+	debugfs_remove(data);
+}
+
+/**
+ * rpmh_queue_debugfs_init: Expose the queue statistics of a controller
+ *
+ * @dev: The device of the controller, the file is removed when it unbinds
+ * @ctrlr: The controller
+ *
+ * Statistics of the queue are exposed in debugfs as rpmh/<drv name>. Only
+ * call this once the probe of @dev can no longer fail.
+ */
+void rpmh_queue_debugfs_init(struct device *dev, struct rpmh_ctrlr *ctrlr)
+{
+	struct dentry *file;
+
+	if (!rpmh_debugfs_dir)
+		rpmh_debugfs_dir = debugfs_create_dir("rpmh", NULL);
+
+	file = debugfs_create_file(ctrlr_to_drv(ctrlr)->name, 0444,
+				   rpmh_debugfs_dir, ctrlr,
+				   &rpmh_queue_stats_fops);
+
+	devm_add_action_or_reset(dev, rpmh_queue_debugfs_exit, file);
+}
+
 static int is_req_valid(struct cache_req *req)
 {
 	return (req->sleep_val != UINT_MAX &&
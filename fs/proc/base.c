@@ -3228,6 +3228,36 @@ static int proc_pid_ksm_stat(struct seq_file *m, struct pid_namespace *ns,
 }
 #endif /* CONFIG_KSM */
 
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+static int proc_pid_vma_lock_stats(struct seq_file *m, struct pid_namespace *ns,
+				   struct pid *pid, struct task_struct *task)
+{
+	static const char * const fallback_names[NR_VMA_FALLBACK] = {
+		"abort", "access", "anon", "fault", "device",
+	};
+	static const char * const wait_names[NR_MMAP_LOCK_WAIT_BUCKETS] = {
+		"10us", "100us", "1ms", "10ms", "inf",
+	};
+	struct mm_vma_lock_stats *stats;
+	struct mm_struct *mm;
+	int i;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		stats = &mm->vma_lock_stats;
+		for (i = 0; i < NR_VMA_FALLBACK; i++)
+			seq_printf(m, "fallback_%s %ld\n", fallback_names[i],
+				   atomic_long_read(&stats->fallback[i]));
+		for (i = 0; i < NR_MMAP_LOCK_WAIT_BUCKETS; i++)
+			seq_printf(m, "mmap_lock_wait_%s %ld\n", wait_names[i],
+				   atomic_long_read(&stats->mmap_lock_wait[i]));
+		mmput(mm);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_PER_VMA_LOCK_STATS */
+
 #ifdef CONFIG_STACKLEAK_METRICS
 static int proc_stack_depth(struct seq_file *m, struct pid_namespace *ns,
 				struct pid *pid, struct task_struct *task)
@@ -3366,6 +3396,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	ONE("ksm_merging_pages",  S_IRUSR, proc_pid_ksm_merging_pages),
 	ONE("ksm_stat",  S_IRUSR, proc_pid_ksm_stat),
 #endif
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+	ONE("vma_lock_stats",  S_IRUSR, proc_pid_vma_lock_stats),
+#endif
 };
 
 static int proc_tgid_base_readdir(struct file *file, struct dir_context *ctx)
@@ -3705,6 +3738,9 @@ static const struct pid_entry tid_base_stuff[] = {
 	ONE("ksm_merging_pages",  S_IRUSR, proc_pid_ksm_merging_pages),
 	ONE("ksm_stat",  S_IRUSR, proc_pid_ksm_stat),
 #endif
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+	ONE("vma_lock_stats",  S_IRUSR, proc_pid_vma_lock_stats),
+#endif
 #ifdef CONFIG_CPU_FREQ_TIMES
 	ONE("time_in_state", 0444, proc_time_in_state_show),
 #endif
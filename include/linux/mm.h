@@ -773,6 +773,16 @@ static inline void assert_fault_locked(struct vm_fault *vmf)
 struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
 					  unsigned long address);
 
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+#define count_vma_lock_fallback(mm, reason)				\
+do {									\
+	count_vm_event(VMA_LOCK_##reason);				\
+	atomic_long_inc(&(mm)->vma_lock_stats.fallback[VMA_FALLBACK_##reason]); \
+} while (0)
+#else
+#define count_vma_lock_fallback(mm, reason) do {} while (0)
+#endif
+
 #else /* CONFIG_PER_VMA_LOCK */
 
 static inline bool vma_start_read(struct vm_area_struct *vma)
@@ -790,6 +800,8 @@ static inline struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
 	return NULL;
 }
 
+#define count_vma_lock_fallback(mm, reason) do {} while (0)
+
 static inline void vma_assert_locked(struct vm_area_struct *vma)
 {
 	mmap_assert_locked(vma->vm_mm);
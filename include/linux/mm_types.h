@@ -706,6 +706,26 @@ struct mm_cid {
 };
 #endif
 
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+/* Why a page fault fell back from the per-VMA lock to mmap_lock */
+enum vma_lock_fallback {
+	VMA_FALLBACK_ABORT,	/* VMA not found or being modified */
+	VMA_FALLBACK_ACCESS,	/* access not permitted by the VMA */
+	VMA_FALLBACK_ANON,	/* anon_vma not prepared, mmap_lock contended */
+	VMA_FALLBACK_FAULT,	/* ->fault without ->map_pages */
+	VMA_FALLBACK_DEVICE,	/* device private page needs migrate_to_ram */
+	NR_VMA_FALLBACK
+};
+
+/* Contended mmap_lock waits in the fault path: <10us ... >=10ms */
+#define NR_MMAP_LOCK_WAIT_BUCKETS	5
+
+struct mm_vma_lock_stats {
+	atomic_long_t fallback[NR_VMA_FALLBACK];
+	atomic_long_t mmap_lock_wait[NR_MMAP_LOCK_WAIT_BUCKETS];
+};
+#endif
+
 struct kioctx_table;
 struct mm_struct {
 	struct {
@@ -821,6 +841,9 @@ struct mm_struct {
 		 */
 		int mm_lock_seq;
 #endif
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+		struct mm_vma_lock_stats vma_lock_stats;
+#endif
 
 
 		unsigned long hiwater_rss; /* High-watermark of RSS usage */
@@ -12,6 +12,7 @@ extern struct page_ext_operations page_pinner_ops;
 extern void __free_page_pinner(struct page *page, unsigned int order);
 void __page_pinner_failure_detect(struct page *page);
 void __page_pinner_put_page(struct page *page);
+void __page_pinner_record_pin(struct page **pages, long nr, unsigned long ip);
 
 static inline void free_page_pinner(struct page *page, unsigned int order)
 {
@@ -34,6 +35,16 @@ static inline void page_pinner_failure_detect(struct page *page)
 
 	__page_pinner_failure_detect(page);
 }
+
+static inline void page_pinner_record_pin(struct page **pages, long nr,
+					  unsigned long ip)
+{
+	if (!static_branch_unlikely(&page_pinner_inited))
+		return;
+
+	if (pages && nr > 0)
+		__page_pinner_record_pin(pages, nr, ip);
+}
 #else
 static inline void free_page_pinner(struct page *page, unsigned int order)
 {
@@ -44,5 +55,9 @@ static inline void page_pinner_put_page(struct page *page)
 static inline void page_pinner_failure_detect(struct page *page)
 {
 }
+static inline void page_pinner_record_pin(struct page **pages, long nr,
+					  unsigned long ip)
+{
+}
 #endif /* CONFIG_PAGE_PINNER */
 #endif /* __LINUX_PAGE_PINNER_H */
@@ -13,6 +13,7 @@
 #include <linux/refcount.h>
 
 struct rethook_node;
+struct rethook_cache;
 
 typedef void (*rethook_handler_t) (struct rethook_node *, void *, unsigned long, struct pt_regs *);
 
@@ -21,6 +22,9 @@ typedef void (*rethook_handler_t) (struct rethook_node *, void *, unsigned long,
  * @data: The user-defined data storage.
  * @handler: The user-defined return hook handler.
  * @pool: The pool of struct rethook_node.
+ * @cache: Per-CPU caches in front of @pool (or NULL).
+ * @cache_max: The number of nodes each CPU may keep in @cache.
+ * @nr_nodes: The number of nodes added to this rethook.
  * @ref: The reference counter.
  * @rcu: The rcu_head for deferred freeing.
  *
@@ -36,6 +40,9 @@ struct rethook {
 	 */
 	void (__rcu *handler) (struct rethook_node *, void *, unsigned long, struct pt_regs *);
 	struct freelist_head	pool;
+	struct rethook_cache __percpu *cache;
+	unsigned int		cache_max;
+	unsigned int		nr_nodes;
 	refcount_t		ref;
 	struct rcu_head		rcu;
 };
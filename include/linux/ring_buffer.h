@@ -182,6 +182,11 @@ void ring_buffer_read_prepare_sync(void);
 void ring_buffer_read_start(struct ring_buffer_iter *iter);
 void ring_buffer_read_finish(struct ring_buffer_iter *iter);
 
+struct ring_buffer_iter *
+ring_buffer_cursor_open(struct trace_buffer *buffer, int cpu, gfp_t flags);
+struct ring_buffer_event *
+ring_buffer_cursor_read(struct ring_buffer_iter *iter, u64 *ts);
+
 struct ring_buffer_event *
 ring_buffer_iter_peek(struct ring_buffer_iter *iter, u64 *ts);
 void ring_buffer_iter_advance(struct ring_buffer_iter *iter);
@@ -58,6 +58,22 @@ struct devfreq_msm_adreno_tz_data {
 	u32 mod_percent;
 	/* Increase IB vote on high ddr stall */
 	bool fast_bus_hint;
+	/* In-kernel DCVS policy used instead of, or compared with, TZ */
+	struct {
+		u32 engine;
+		u32 up_threshold;
+		u32 down_threshold;
+		s32 bias;
+		bool tz_stale;
+		struct {
+			u64 count;
+			u64 total_ns;
+			u64 max_ns;
+		} latency[2];
+		u64 agree;
+		u64 local_higher;
+		u64 local_lower;
+	} dcvs;
 };
 
 struct msm_adreno_extended_profile {
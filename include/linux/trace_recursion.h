@@ -73,6 +73,13 @@ enum {
 	 */
 	TRACE_GRAPH_NOTRACE_BIT,
 
+	/*
+	 * Set when the function graph tracer sampled out the root of a call
+	 * tree: the functions it calls are ignored, until its return clears
+	 * the bit.
+	 */
+	TRACE_GRAPH_SAMPLE_BIT,
+
 	/* Used to prevent recursion recording from recursing. */
 	TRACE_RECORD_RECURSION_BIT,
 };
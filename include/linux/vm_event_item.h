@@ -158,7 +158,22 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		VMA_LOCK_ABORT,
 		VMA_LOCK_RETRY,
 		VMA_LOCK_MISS,
+		VMA_LOCK_ACCESS,
+		VMA_LOCK_ANON,
+		VMA_LOCK_FAULT,
+		VMA_LOCK_DEVICE,
+		VMA_LOCK_IO_RETRY,
 #endif
+#ifdef CONFIG_SWAP
+		SWAP_RA_INMEM_SKIP,
+#endif
+#ifdef CONFIG_LRU_GEN
+		LRU_GEN_PROACTIVE_RECLAIM,
+		LRU_GEN_PROACTIVE_REFAULT,
+		LRU_GEN_PROACTIVE_BACKOFF,
+#endif
+		RA_REPLAY,
+		RA_REPLAY_PAGES,
 		NR_VM_EVENT_ITEMS
 };
 
@@ -8,9 +8,15 @@
 extern u64 zswap_pool_total_size;
 extern atomic_t zswap_stored_pages;
 
+/* Max number of folios handed to zswap_store_batch() at once */
+#define ZSWAP_STORE_BATCH_MAX	16
+
 #ifdef CONFIG_ZSWAP
 
 bool zswap_store(struct folio *folio);
+int zswap_store_batch(struct folio **folios, int nr, unsigned long *stored);
+bool zswap_store_batch_enabled(void);
+bool zswap_stored(swp_entry_t swp);
 bool zswap_load(struct folio *folio);
 void zswap_invalidate(int type, pgoff_t offset);
 void zswap_swapon(int type);
@@ -23,6 +29,23 @@ static inline bool zswap_store(struct folio *folio)
 	return false;
 }
 
+static inline int zswap_store_batch(struct folio **folios, int nr,
+				    unsigned long *stored)
+{
+	*stored = 0;
+	return 0;
+}
+
+static inline bool zswap_store_batch_enabled(void)
+{
+	return false;
+}
+
+static inline bool zswap_stored(swp_entry_t swp)
+{
+	return false;
+}
+
 static inline bool zswap_load(struct folio *folio)
 {
 	return false;
@@ -21,6 +21,9 @@ int rpmh_write_async(const struct device *dev, enum rpmh_state state,
 int rpmh_write_batch(const struct device *dev, enum rpmh_state state,
 		     const struct tcs_cmd *cmd, u32 *n);
 
+int rpmh_write_queued(const struct device *dev, const struct tcs_cmd *cmd,
+		      u32 n, void (*done)(void *data, int err), void *data);
+
 int rpmh_mode_solver_set(const struct device *dev, bool enable);
 
 int rpmh_write_sleep_and_wake(const struct device *dev);
@@ -55,6 +58,12 @@ static inline int rpmh_write_batch(const struct device *dev,
 				   const struct tcs_cmd *cmd, u32 *n)
 { return -ENODEV; }
 
+static inline int rpmh_write_queued(const struct device *dev,
+				    const struct tcs_cmd *cmd, u32 n,
+				    void (*done)(void *data, int err),
+				    void *data)
+{ return -ENODEV; }
+
 static inline int rpmh_mode_solver_set(const struct device *dev, bool enable)
 { return -ENODEV; }
 
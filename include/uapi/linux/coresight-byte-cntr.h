@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef __UAPI_CORESIGHT_BYTE_CNTR_H_
+#define __UAPI_CORESIGHT_BYTE_CNTR_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Ring view of the TMC ETR buffer drained through the byte counter
+ * device. The trace buffer is mapped read-only with mmap() at offset 0.
+ * Trace data is ready from @tail (consumer) up to @head (producer),
+ * @avail bytes in total, wrapping around at @size. Readers hand the
+ * space back with BYTE_CNTR_IOC_RING_CONSUME once they are done with it.
+ * @lost counts the bytes overwritten by the ETR before they were consumed.
+ */
+struct byte_cntr_ring_info {
+	__u64	size;
+	__u64	head;
+	__u64	tail;
+	__u64	avail;
+	__u64	lost;
+	__u32	block_size;
+	__u32	flags;
+};
+
+/* Tracing has stopped, only the remaining data is left in the ring */
+#define BYTE_CNTR_RING_STOPPED		(1 << 0)
+
+#define BYTE_CNTR_IOC_MAGIC		0xBC
+#define BYTE_CNTR_IOC_RING_INFO		_IOR(BYTE_CNTR_IOC_MAGIC, 0, \
+					     struct byte_cntr_ring_info)
+#define BYTE_CNTR_IOC_RING_CONSUME	_IOW(BYTE_CNTR_IOC_MAGIC, 1, __u64)
+
+#endif
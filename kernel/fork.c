@@ -1297,6 +1297,9 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	INIT_LIST_HEAD(&mm->mmlist);
 #ifdef CONFIG_PER_VMA_LOCK
 	mm->mm_lock_seq = 0;
+#endif
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+	memset(&mm->vma_lock_stats, 0, sizeof(mm->vma_lock_stats));
 #endif
 	mm_pgtables_bytes_init(mm);
 	mm->map_count = 0;
@@ -296,10 +296,21 @@ static int msg_read(struct ipc_log_context *ilctxt,
 static void msg_drop(struct ipc_log_context *ilctxt)
 {
 	struct tsv_header hdr;
+	char *archive = NULL;
+	bool unread;
 
 	if (!is_read_empty(ilctxt)) {
+		/* messages nobody has read yet go to the archive */
+		unread = is_nd_read_equal_read(ilctxt);
 		ipc_log_drop(ilctxt, &hdr, sizeof(hdr));
-		ipc_log_drop(ilctxt, NULL, (int)hdr.size);
+		if (unread)
+			archive = ipc_log_archive_reserve(ilctxt,
+					sizeof(hdr) + hdr.size);
+		if (archive) {
+			memcpy(archive, &hdr, sizeof(hdr));
+			archive += sizeof(hdr);
+		}
+		ipc_log_drop(ilctxt, archive, (int)hdr.size);
 	}
 }
 
@@ -811,6 +822,25 @@ static void *get_deserialization_func(struct ipc_log_context *ilctxt,
 	return NULL;
 }
 
+/*
+ * Looks up a deserialization function for readers outside of this file,
+ * taking the context lock that get_deserialization_func() expects.
+ */
+void *ipc_log_get_dfunc(struct ipc_log_context *ilctxt, int type)
+{
+	unsigned long flags;
+	void *dfunc = NULL;
+
+	read_lock_irqsave(&context_list_lock_lha1, flags);
+	spin_lock(&ilctxt->context_lock_lhb1);
+	if (!ilctxt->destroyed)
+		dfunc = get_deserialization_func(ilctxt, type);
+	spin_unlock(&ilctxt->context_lock_lhb1);
+	read_unlock_irqrestore(&context_list_lock_lha1, flags);
+
+	return dfunc;
+}
+
 /**
  * ipc_log_context_create: Create a debug log context if context does not exist.
  *                         Should not be called from atomic context
@@ -897,6 +927,7 @@ void *ipc_log_context_create(int max_num_pages,
 	ctxt->header_size = sizeof(struct ipc_log_page_header);
 	kref_init(&ctxt->refcount);
 	ctxt->destroyed = false;
+	ipc_log_archive_create(ctxt);
 	create_ctx_debugfs(ctxt, mod_name);
 	ipc_log_cdev_create(ctxt, mod_name);
 	/* set magic last to signal context init is complete */
@@ -929,6 +960,7 @@ void ipc_log_context_free(struct kref *kref)
 				struct ipc_log_context, refcount);
 	struct ipc_log_page *pg = NULL;
 
+	ipc_log_archive_free(ilctxt);
 	while (!list_empty(&ilctxt->page_list)) {
 		pg = get_first_page(ilctxt);
 		list_del(&pg->hdr.list);
@@ -977,6 +1009,7 @@ static int __init ipc_logging_init(void)
 {
 	check_and_create_debugfs();
 	ipc_log_cdev_init();
+	ipc_log_archive_init();
 	register_minidump((u64)&ipc_log_context_list, sizeof(struct list_head),
 			  "ipc_log_ctxt_list", minidump_buf_cnt);
 
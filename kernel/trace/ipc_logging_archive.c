@@ -0,0 +1,451 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ */
+
+/*
+ * Compressed second tier of an ipc logging context.
+ *
+ * Messages which are dropped from the page ring before anybody read them
+ * are copied into a staging buffer instead of being lost.  Full staging
+ * buffers are LZ4 compressed from a workqueue into a bounded FIFO of
+ * chunks, oldest chunks being evicted first.  The character device drains
+ * the archive ahead of the live pages, so a reader gets the history in
+ * order.  Messages still sitting in the staging buffer only become readable
+ * once that buffer has been compressed.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/lz4.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/ipc_logging.h>
+
+#include "ipc_logging_private.h"
+
+#define ARCHIVE_STAGE_SIZE	PAGE_SIZE
+
+static unsigned int archive_kb = 64;
+module_param(archive_kb, uint, 0644);
+MODULE_PARM_DESC(archive_kb,
+		 "Compressed history kept per log context in KB (0 disables)");
+
+/**
+ * struct ipc_log_archive_chunk - One compressed staging buffer
+ *
+ * @list: Entry in ipc_log_archive::chunks
+ * @start_time: Scheduler clock when the first message was archived
+ * @end_time: Scheduler clock when the last message was archived
+ * @raw_len: Size of the data once decompressed
+ * @comp_len: Size of @data
+ * @data: LZ4 compressed messages (struct tsv_header followed by payload)
+ */
+struct ipc_log_archive_chunk {
+	struct list_head list;
+	u64 start_time;
+	u64 end_time;
+	u32 raw_len;
+	u32 comp_len;
+	char data[];
+};
+
+/**
+ * struct ipc_log_archive - Compressed history of a logging context
+ *
+ * @stage: Staging buffers, one being filled while the other is compressed
+ * @fill: Index of the staging buffer being filled
+ * @fill_len: Bytes used in the staging buffer being filled
+ * @fill_msgs: Messages in the staging buffer being filled
+ * @fill_start: Scheduler clock of the first message being staged
+ * @fill_end: Scheduler clock of the last message being staged
+ * @pending: Staging buffer handed to @work, NULL when @work is idle
+ * @pending_len: Bytes used in @pending
+ * @pending_start: Start time of @pending
+ * @pending_end: End time of @pending
+ * @work: Compresses @pending into a new chunk
+ * @lock: Protects @pending, @chunks and the statistics
+ * @chunks: Compressed chunks, oldest first
+ * @bytes: Memory held by @chunks
+ * @raw_bytes: Uncompressed bytes ever archived
+ * @comp_bytes: Compressed bytes ever archived
+ * @comp_ns: Time spent compressing
+ * @nr_chunks: Chunks ever archived
+ * @nr_evicted: Chunks evicted to stay within archive_kb
+ * @nr_lost: Messages lost because compression fell behind
+ * @read_lock: Serializes readers of the archive
+ * @read_buf: Decompressed chunk being read
+ * @read_len: Bytes in @read_buf
+ * @read_off: Read offset in @read_buf
+ *
+ * The staging state is only touched by the writer with
+ * ipc_log_context::context_lock_lhb1 held.
+ */
+struct ipc_log_archive {
+	char *stage[2];
+	int fill;
+	int fill_len;
+	int fill_msgs;
+	u64 fill_start;
+	u64 fill_end;
+
+	char *pending;
+	int pending_len;
+	u64 pending_start;
+	u64 pending_end;
+	struct work_struct work;
+
+	spinlock_t lock;
+	struct list_head chunks;
+	size_t bytes;
+	u64 raw_bytes;
+	u64 comp_bytes;
+	u64 comp_ns;
+	u64 nr_chunks;
+	u64 nr_evicted;
+	u64 nr_lost;
+
+	struct mutex read_lock;
+	char *read_buf;
+	int read_len;
+	int read_off;
+};
+
+/* LZ4 scratch memory is shared by all contexts */
+static DEFINE_MUTEX(archive_wrkmem_lock);
+static void *archive_wrkmem;
+
+static size_t archive_limit(void)
+{
+	return (size_t)READ_ONCE(archive_kb) * SZ_1K;
+}
+
+static void ipc_log_archive_work(struct work_struct *work)
+{
+	struct ipc_log_archive *ar = container_of(work, struct ipc_log_archive,
+						  work);
+	struct ipc_log_archive_chunk *chunk, *tmp;
+	unsigned long flags;
+	LIST_HEAD(evicted);
+	u64 comp_ns = 0;
+	int len;
+
+	chunk = kmalloc(struct_size(chunk, data,
+				    LZ4_COMPRESSBOUND(ARCHIVE_STAGE_SIZE)),
+			GFP_KERNEL);
+	if (chunk) {
+		mutex_lock(&archive_wrkmem_lock);
+		comp_ns = local_clock();
+		len = LZ4_compress_default(ar->pending, chunk->data,
+					   ar->pending_len,
+					   LZ4_COMPRESSBOUND(ARCHIVE_STAGE_SIZE),
+					   archive_wrkmem);
+		comp_ns = local_clock() - comp_ns;
+		mutex_unlock(&archive_wrkmem_lock);
+
+		if (len > 0) {
+			tmp = krealloc(chunk, struct_size(chunk, data, len),
+				       GFP_KERNEL);
+			if (tmp)
+				chunk = tmp;
+			chunk->start_time = ar->pending_start;
+			chunk->end_time = ar->pending_end;
+			chunk->raw_len = ar->pending_len;
+			chunk->comp_len = len;
+		} else {
+			kfree(chunk);
+			chunk = NULL;
+		}
+	}
+
+	spin_lock_irqsave(&ar->lock, flags);
+	if (chunk) {
+		list_add_tail(&chunk->list, &ar->chunks);
+		ar->bytes += struct_size(chunk, data, chunk->comp_len);
+		ar->raw_bytes += chunk->raw_len;
+		ar->comp_bytes += chunk->comp_len;
+		ar->comp_ns += comp_ns;
+		ar->nr_chunks++;
+	}
+	while (ar->bytes > archive_limit() && !list_empty(&ar->chunks)) {
+		tmp = list_first_entry(&ar->chunks,
+				       struct ipc_log_archive_chunk, list);
+		list_move_tail(&tmp->list, &evicted);
+		ar->bytes -= struct_size(tmp, data, tmp->comp_len);
+		ar->nr_evicted++;
+	}
+	ar->pending = NULL;
+	spin_unlock_irqrestore(&ar->lock, flags);
+
+	list_for_each_entry_safe(chunk, tmp, &evicted, list)
+		kfree(chunk);
+}
+
+/**
+ * ipc_log_archive_reserve() - Reserve room for a message about to be dropped
+ *
+ * @ilctxt: Logging context, with context_lock_lhb1 held
+ * @len: Size of the message including its struct tsv_header
+ *
+ * Return: Where to copy the message, NULL if it can't be archived
+ */
+char *ipc_log_archive_reserve(struct ipc_log_context *ilctxt, int len)
+{
+	struct ipc_log_archive *ar = ilctxt->archive;
+	u64 t_now;
+	char *p;
+
+	if (!ar || !READ_ONCE(archive_kb))
+		return NULL;
+
+	if (ar->fill_len + len > ARCHIVE_STAGE_SIZE) {
+		spin_lock(&ar->lock);
+		if (ar->pending) {
+			/* compression is behind, give up on what is staged */
+			ar->nr_lost += ar->fill_msgs;
+		} else {
+			ar->pending = ar->stage[ar->fill];
+			ar->pending_len = ar->fill_len;
+			ar->pending_start = ar->fill_start;
+			ar->pending_end = ar->fill_end;
+			ar->fill ^= 1;
+			queue_work(system_unbound_wq, &ar->work);
+		}
+		spin_unlock(&ar->lock);
+		ar->fill_len = 0;
+		ar->fill_msgs = 0;
+	}
+
+	t_now = sched_clock();
+	if (!ar->fill_len)
+		ar->fill_start = t_now;
+	ar->fill_end = t_now;
+
+	p = ar->stage[ar->fill] + ar->fill_len;
+	ar->fill_len += len;
+	ar->fill_msgs++;
+
+	return p;
+}
+
+/*
+ * Decompresses the oldest chunk into ipc_log_archive::read_buf.
+ *
+ * Returns 0 on success, -ENODATA when the archive is empty.
+ */
+static int ipc_log_archive_next(struct ipc_log_archive *ar)
+{
+	struct ipc_log_archive_chunk *chunk;
+	unsigned long flags;
+	int len;
+
+	if (!ar->read_buf) {
+		ar->read_buf = kmalloc(ARCHIVE_STAGE_SIZE, GFP_KERNEL);
+		if (!ar->read_buf)
+			return -ENOMEM;
+	}
+
+	do {
+		spin_lock_irqsave(&ar->lock, flags);
+		chunk = list_first_entry_or_null(&ar->chunks,
+						 struct ipc_log_archive_chunk,
+						 list);
+		if (chunk) {
+			list_del(&chunk->list);
+			ar->bytes -= struct_size(chunk, data,
+						 chunk->comp_len);
+		}
+		spin_unlock_irqrestore(&ar->lock, flags);
+
+		if (!chunk)
+			return -ENODATA;
+
+		len = LZ4_decompress_safe(chunk->data, ar->read_buf,
+					  chunk->comp_len, ARCHIVE_STAGE_SIZE);
+		if (len != chunk->raw_len) {
+			pr_err("%s: corrupted chunk %d/%u\n", __func__,
+			       len, chunk->raw_len);
+			len = 0;
+		}
+		kfree(chunk);
+	} while (!len);
+
+	ar->read_len = len;
+	ar->read_off = 0;
+
+	return 0;
+}
+
+/**
+ * ipc_log_archive_extract() - Read and deserialize archived messages
+ *
+ * @ilctxt: Logging context
+ * @buff: Buffer to receive the decoded messages
+ * @size: Size of @buff
+ *
+ * Archived messages are consumed, the same way ipc_log_extract() moves the
+ * non-destructive read pointer of the live pages.
+ *
+ * Return: Number of bytes written to @buff, 0 if the archive is empty
+ */
+int ipc_log_archive_extract(struct ipc_log_context *ilctxt, char *buff,
+			    int size)
+{
+	struct ipc_log_archive *ar = ilctxt->archive;
+	struct encode_context ectxt;
+	struct decode_context dctxt;
+	void (*deserialize_func)(struct encode_context *ectxt,
+				 struct decode_context *dctxt);
+	struct tsv_header hdr;
+
+	if (!ar)
+		return 0;
+
+	if (size < MAX_MSG_DECODED_SIZE)
+		return -EINVAL;
+
+	dctxt.output_format = OUTPUT_DEBUGFS;
+	dctxt.buff = buff;
+	dctxt.size = size;
+
+	mutex_lock(&ar->read_lock);
+	while (dctxt.size >= MAX_MSG_DECODED_SIZE) {
+		if (ar->read_off >= ar->read_len &&
+		    ipc_log_archive_next(ar))
+			break;
+
+		memcpy(&hdr, ar->read_buf + ar->read_off, sizeof(hdr));
+		if (ar->read_off + sizeof(hdr) + hdr.size > ar->read_len) {
+			ar->read_off = ar->read_len;
+			continue;
+		}
+
+		ectxt.hdr = hdr;
+		ectxt.offset = sizeof(hdr);
+		memcpy(ectxt.buff, ar->read_buf + ar->read_off,
+		       sizeof(hdr) + hdr.size);
+		ar->read_off += sizeof(hdr) + hdr.size;
+
+		deserialize_func = ipc_log_get_dfunc(ilctxt, hdr.type);
+		if (deserialize_func)
+			deserialize_func(&ectxt, &dctxt);
+		else
+			pr_err("%s: unknown message 0x%x\n", __func__, hdr.type);
+	}
+	mutex_unlock(&ar->read_lock);
+
+	return size - dctxt.size;
+}
+
+static int ipc_log_archive_stats_show(struct seq_file *s, void *unused)
+{
+	struct ipc_log_context *ilctxt = s->private;
+	struct ipc_log_archive *ar = ilctxt->archive;
+	struct ipc_log_archive_chunk *chunk;
+	u64 span = 0, per_hour = 0, ns_per_kb = 0;
+	u64 raw, comp, comp_ns, nr_chunks, nr_evicted, nr_lost;
+	unsigned long flags;
+	size_t bytes;
+
+	spin_lock_irqsave(&ar->lock, flags);
+	if (!list_empty(&ar->chunks)) {
+		chunk = list_first_entry(&ar->chunks,
+					 struct ipc_log_archive_chunk, list);
+		span = list_last_entry(&ar->chunks,
+				       struct ipc_log_archive_chunk,
+				       list)->end_time - chunk->start_time;
+	}
+	bytes = ar->bytes;
+	raw = ar->raw_bytes;
+	comp = ar->comp_bytes;
+	comp_ns = ar->comp_ns;
+	nr_chunks = ar->nr_chunks;
+	nr_evicted = ar->nr_evicted;
+	nr_lost = ar->nr_lost;
+	spin_unlock_irqrestore(&ar->lock, flags);
+
+	if (span)
+		per_hour = div64_u64((u64)bytes * 3600, div64_u64(span,
+					NSEC_PER_SEC) ? : 1);
+	if (raw >= SZ_1K)
+		ns_per_kb = div64_u64(comp_ns, raw / SZ_1K);
+
+	seq_printf(s, "limit_bytes: %zu\n", archive_limit());
+	seq_printf(s, "stored_bytes: %zu\n", bytes);
+	seq_printf(s, "history_ms: %llu\n", div64_u64(span, NSEC_PER_MSEC));
+	seq_printf(s, "bytes_per_hour: %llu\n", per_hour);
+	seq_printf(s, "raw_bytes: %llu\n", raw);
+	seq_printf(s, "compressed_bytes: %llu\n", comp);
+	seq_printf(s, "compress_ns: %llu\n", comp_ns);
+	seq_printf(s, "compress_ns_per_kb: %llu\n", ns_per_kb);
+	seq_printf(s, "chunks: %llu\n", nr_chunks);
+	seq_printf(s, "evicted: %llu\n", nr_evicted);
+	seq_printf(s, "lost_msgs: %llu\n", nr_lost);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ipc_log_archive_stats);
+
+void ipc_log_archive_debugfs_create(struct ipc_log_context *ilctxt)
+{
+	if (ilctxt->archive && !IS_ERR_OR_NULL(ilctxt->dent))
+		debugfs_create_file("archive_stats", 0444, ilctxt->dent,
+				    ilctxt, &ipc_log_archive_stats_fops);
+}
+
+void ipc_log_archive_create(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_archive *ar;
+
+	if (!archive_wrkmem || !READ_ONCE(archive_kb))
+		return;
+
+	ar = kzalloc(sizeof(*ar), GFP_KERNEL);
+	if (!ar)
+		return;
+
+	ar->stage[0] = kmalloc(ARCHIVE_STAGE_SIZE, GFP_KERNEL);
+	ar->stage[1] = kmalloc(ARCHIVE_STAGE_SIZE, GFP_KERNEL);
+	if (!ar->stage[0] || !ar->stage[1]) {
+		kfree(ar->stage[0]);
+		kfree(ar->stage[1]);
+		kfree(ar);
+		return;
+	}
+
+	INIT_WORK(&ar->work, ipc_log_archive_work);
+	spin_lock_init(&ar->lock);
+	INIT_LIST_HEAD(&ar->chunks);
+	mutex_init(&ar->read_lock);
+	ilctxt->archive = ar;
+}
+
+void ipc_log_archive_free(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_archive *ar = ilctxt->archive;
+	struct ipc_log_archive_chunk *chunk, *tmp;
+
+	if (!ar)
+		return;
+
+	cancel_work_sync(&ar->work);
+	list_for_each_entry_safe(chunk, tmp, &ar->chunks, list)
+		kfree(chunk);
+	kfree(ar->read_buf);
+	kfree(ar->stage[0]);
+	kfree(ar->stage[1]);
+	kfree(ar);
+	ilctxt->archive = NULL;
+}
+
+void ipc_log_archive_init(void)
+{
+	archive_wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!archive_wrkmem)
+		pr_err("%s: no LZ4 work memory, archive disabled\n", __func__);
+}
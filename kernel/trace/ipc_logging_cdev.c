@@ -45,6 +45,12 @@ static int debug_log(struct ipc_log_context *ilctxt, char *buff, int size, int c
 		pr_err("%s: buffer size %d < %d\n", __func__, size, MAX_MSG_DECODED_SIZE);
 		return -ENOMEM;
 	}
+
+	/* history that was dropped from the pages comes first */
+	i = ipc_log_archive_extract(ilctxt, buff, size - 1);
+	if (i)
+		return i;
+
 	do {
 		i = ipc_log_extract(ilctxt, buff, size - 1);
 		if (cont && i == 0) {
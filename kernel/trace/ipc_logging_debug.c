@@ -183,6 +183,7 @@ void create_ctx_debugfs(struct ipc_log_context *ctxt,
 				     ctxt, &debug_ops);
 			debug_create("log_cont", 0444, ctxt->dent,
 				     ctxt, &debug_ops_cont);
+			ipc_log_archive_debugfs_create(ctxt);
 		}
 	}
 	add_deserialization_func((void *)ctxt,
@@ -12,6 +12,8 @@
 #define IPC_LOG_VERSION 0x0003
 #define IPC_LOG_MAX_CONTEXT_NAME_LEN 32
 
+struct ipc_log_archive;
+
 /**
  * struct ipc_log_page_header - Individual log page header
  *
@@ -103,6 +105,7 @@ struct ipc_log_cdev {
  * @context_lock_lhb1:  Lock for entire structure
  * @read_avail:  Completed when new data is added to the log
  * @cdev: Ipc logging character device
+ * @archive: Compressed history of dropped messages (or NULL)
  */
 struct ipc_log_context {
 	uint32_t magic;
@@ -130,6 +133,7 @@ struct ipc_log_context {
 	struct kref refcount;
 	bool destroyed;
 	struct ipc_log_cdev cdev;
+	struct ipc_log_archive *archive;
 };
 
 struct dfunc_info {
@@ -159,6 +163,7 @@ enum {
 #define MAX_MSG_DECODED_SIZE (MAX_MSG_SIZE*4)
 
 void ipc_log_context_free(struct kref *kref);
+void *ipc_log_get_dfunc(struct ipc_log_context *ilctxt, int type);
 
 static inline void ipc_log_context_put(struct ipc_log_context *ilctxt)
 {
@@ -190,4 +195,26 @@ static inline void ipc_log_cdev_create(struct ipc_log_context *ilctxt, const cha
 static inline void ipc_log_cdev_remove(struct ipc_log_context *ilctxt) {}
 #endif
 
+#if IS_ENABLED(CONFIG_IPC_LOGGING_ARCHIVE)
+void ipc_log_archive_init(void);
+void ipc_log_archive_create(struct ipc_log_context *ilctxt);
+void ipc_log_archive_free(struct ipc_log_context *ilctxt);
+void ipc_log_archive_debugfs_create(struct ipc_log_context *ilctxt);
+char *ipc_log_archive_reserve(struct ipc_log_context *ilctxt, int len);
+int ipc_log_archive_extract(struct ipc_log_context *ilctxt, char *buff, int size);
+#else
+static inline void ipc_log_archive_init(void) {}
+static inline void ipc_log_archive_create(struct ipc_log_context *ilctxt) {}
+static inline void ipc_log_archive_free(struct ipc_log_context *ilctxt) {}
+static inline void ipc_log_archive_debugfs_create(struct ipc_log_context *ilctxt) {}
+static inline char *ipc_log_archive_reserve(struct ipc_log_context *ilctxt, int len)
+{
+	return NULL;
+}
+static inline int ipc_log_archive_extract(struct ipc_log_context *ilctxt, char *buff, int size)
+{
+	return 0;
+}
+#endif
+
 #endif
@@ -5,6 +5,7 @@
 #include <linux/bug.h>
 #include <linux/kallsyms.h>
 #include <linux/kprobes.h>
+#include <linux/percpu.h>
 #include <linux/preempt.h>
 #include <linux/rethook.h>
 #include <linux/slab.h>
@@ -12,6 +13,18 @@
 
 /* Return hook list (shadow stack by list) */
 
+#define RETHOOK_CACHE_SIZE	8
+
+/**
+ * struct rethook_cache - Per-CPU cache of unused rethook nodes.
+ * @nr: The number of cached nodes.
+ * @nodes: The cached nodes, used in LIFO order.
+ */
+struct rethook_cache {
+	unsigned int		nr;
+	struct rethook_node	*nodes[RETHOOK_CACHE_SIZE];
+};
+
 /*
  * This function is called from delayed_put_task_struct() when a task is
  * dead and cleaned up to recycle any kretprobe instances associated with
@@ -36,9 +49,22 @@ void rethook_flush_task(struct task_struct *tk)
 static void rethook_free_rcu(struct rcu_head *head)
 {
 	struct rethook *rh = container_of(head, struct rethook, rcu);
+	struct rethook_cache *cache;
 	struct rethook_node *rhn;
 	struct freelist_node *node;
 	int count = 1;
+	int cpu;
+
+	if (rh->cache) {
+		for_each_possible_cpu(cpu) {
+			cache = per_cpu_ptr(rh->cache, cpu);
+			while (cache->nr) {
+				kfree(cache->nodes[--cache->nr]);
+				count++;
+			}
+		}
+		free_percpu(rh->cache);
+	}
 
 	node = rh->pool.head;
 	while (node) {
@@ -110,6 +136,8 @@ struct rethook *rethook_alloc(void *data, rethook_handler_t handler)
 	rh->data = data;
 	rcu_assign_pointer(rh->handler, handler);
 	rh->pool.head = NULL;
+	/* Without the per-CPU caches, everything goes through the pool. */
+	rh->cache = alloc_percpu(struct rethook_cache);
 	refcount_set(&rh->ref, 1);
 
 	return rh;
@@ -128,6 +156,60 @@ void rethook_add_node(struct rethook *rh, struct rethook_node *node)
 	node->rethook = rh;
 	freelist_add(&node->freelist, &rh->pool);
 	refcount_inc(&rh->ref);
+
+	/*
+	 * Let each CPU keep at most its fair share of the nodes, so that idle
+	 * CPUs can't hold on to more than they would use. With the default
+	 * kretprobe pool of two nodes per CPU, a probed call and one nested
+	 * hit, e.g. from an interrupt, take their nodes from and recycle them
+	 * to the local cache without touching the shared pool.
+	 */
+	rh->nr_nodes++;
+	WRITE_ONCE(rh->cache_max, min_t(unsigned int, RETHOOK_CACHE_SIZE,
+			rh->nr_nodes / num_possible_cpus()));
+}
+
+/*
+ * The per-CPU caches are accessed with interrupts disabled, since probes can
+ * hit in interrupts while the cache is being updated. NMIs use the pool.
+ */
+static __always_inline struct rethook_node *rethook_cache_get(struct rethook *rh)
+{
+	struct rethook_node *node = NULL;
+	struct rethook_cache *cache;
+	unsigned long flags;
+
+	if (!rh->cache || in_nmi())
+		return NULL;
+
+	raw_local_irq_save(flags);
+	cache = this_cpu_ptr(rh->cache);
+	if (cache->nr)
+		node = cache->nodes[--cache->nr];
+	raw_local_irq_restore(flags);
+
+	return node;
+}
+
+static __always_inline bool rethook_cache_put(struct rethook_node *node)
+{
+	struct rethook *rh = node->rethook;
+	struct rethook_cache *cache;
+	unsigned long flags;
+	bool cached = false;
+
+	if (!rh->cache || in_nmi())
+		return false;
+
+	raw_local_irq_save(flags);
+	cache = this_cpu_ptr(rh->cache);
+	if (cache->nr < READ_ONCE(rh->cache_max)) {
+		cache->nodes[cache->nr++] = node;
+		cached = true;
+	}
+	raw_local_irq_restore(flags);
+
+	return cached;
 }
 
 static void free_rethook_node_rcu(struct rcu_head *head)
@@ -151,9 +233,10 @@ void rethook_recycle(struct rethook_node *node)
 	rethook_handler_t handler;
 
 	handler = rethook_get_handler(node->rethook);
-	if (likely(handler))
-		freelist_add(&node->freelist, &node->rethook->pool);
-	else
+	if (likely(handler)) {
+		if (!rethook_cache_put(node))
+			freelist_add(&node->freelist, &node->rethook->pool);
+	} else
 		call_rcu(&node->rcu, free_rethook_node_rcu);
 }
 NOKPROBE_SYMBOL(rethook_recycle);
@@ -168,6 +251,7 @@ NOKPROBE_SYMBOL(rethook_recycle);
 struct rethook_node *rethook_try_get(struct rethook *rh)
 {
 	rethook_handler_t handler = rethook_get_handler(rh);
+	struct rethook_node *node;
 	struct freelist_node *fn;
 
 	/* Check whether @rh is going to be freed. */
@@ -183,6 +267,10 @@ struct rethook_node *rethook_try_get(struct rethook *rh)
 	if (unlikely(!rcu_is_watching()))
 		return NULL;
 
+	node = rethook_cache_get(rh);
+	if (node)
+		return node;
+
 	fn = freelist_try_get(&rh->pool);
 	if (!fn)
 		return NULL;
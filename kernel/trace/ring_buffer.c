@@ -537,10 +537,12 @@ struct ring_buffer_iter {
 	struct buffer_page		*cache_reader_page;
 	unsigned long			cache_read;
 	unsigned long			cache_pages_removed;
+	unsigned long			cache_pages_read;
 	u64				read_stamp;
 	u64				page_stamp;
 	struct ring_buffer_event	*event;
 	int				missed_events;
+	bool				cursor;
 };
 
 #ifdef RB_TIME_32
@@ -4385,6 +4387,7 @@ static void rb_iter_reset(struct ring_buffer_iter *iter)
 	iter->cache_reader_page = iter->head_page;
 	iter->cache_read = cpu_buffer->read;
 	iter->cache_pages_removed = cpu_buffer->pages_removed;
+	iter->cache_pages_read = local_read(&cpu_buffer->pages_read);
 
 	if (iter->head) {
 		iter->read_stamp = cpu_buffer->read_stamp;
@@ -4892,6 +4895,42 @@ rb_buffer_peek(struct ring_buffer_per_cpu *cpu_buffer, u64 *ts,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_peek);
 
+/*
+ * A consuming read happened while a reader cursor is active. Unlike a plain
+ * iterator, the cursor keeps its own position: it is only moved if the
+ * consumer went past it, as the pages behind the consumer have been handed
+ * back to the writer. The reader page is not written to, so the cursor can
+ * pick up from its beginning. Nothing is lost only if the cursor was on the
+ * old reader page, had read all of it, and the consumer swapped just that
+ * page. The old page went back to the writer, so its time stamp is checked
+ * too: if the writer reused it, its size no longer says what the cursor
+ * left unread.
+ */
+static void rb_cursor_sync(struct ring_buffer_iter *iter)
+{
+	struct ring_buffer_per_cpu *cpu_buffer = iter->cpu_buffer;
+	struct buffer_page *reader = cpu_buffer->reader_page;
+	unsigned long pages_read = local_read(&cpu_buffer->pages_read);
+
+	if (iter->head_page != reader &&
+	    iter->page_stamp < reader->page->time_stamp) {
+		if (iter->head_page != iter->cache_reader_page ||
+		    pages_read - iter->cache_pages_read > 1 ||
+		    iter->page_stamp != iter->head_page->page->time_stamp ||
+		    iter->head < rb_page_size(iter->head_page))
+			iter->missed_events = 1;
+
+		iter->head_page = reader;
+		iter->head = 0;
+		iter->next_event = 0;
+		iter->page_stamp = iter->read_stamp = reader->page->time_stamp;
+	}
+
+	iter->cache_reader_page = reader;
+	iter->cache_read = cpu_buffer->read;
+	iter->cache_pages_read = pages_read;
+}
+
 static struct ring_buffer_event *
 rb_iter_peek(struct ring_buffer_iter *iter, u64 *ts)
 {
@@ -4911,10 +4950,15 @@ rb_iter_peek(struct ring_buffer_iter *iter, u64 *ts)
 	 * or removed some pages from the buffer. In these cases,
 	 * iterator was invalidated and we need to reset it.
 	 */
-	if (unlikely(iter->cache_read != cpu_buffer->read ||
-		     iter->cache_reader_page != cpu_buffer->reader_page ||
-		     iter->cache_pages_removed != cpu_buffer->pages_removed))
+	if (unlikely(iter->cache_pages_removed != cpu_buffer->pages_removed))
 		rb_iter_reset(iter);
+	else if (unlikely(iter->cache_read != cpu_buffer->read ||
+			  iter->cache_reader_page != cpu_buffer->reader_page)) {
+		if (iter->cursor)
+			rb_cursor_sync(iter);
+		else
+			rb_iter_reset(iter);
+	}
 
  again:
 	if (ring_buffer_iter_empty(iter))
@@ -5265,6 +5309,69 @@ ring_buffer_read_finish(struct ring_buffer_iter *iter)
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_finish);
 
+/**
+ * ring_buffer_cursor_open - open an independent reader cursor on a cpu buffer
+ * @buffer: The ring buffer to read from
+ * @cpu: The cpu buffer to read
+ * @flags: gfp flags to use for memory allocation
+ *
+ * A reader cursor is a non consuming reader that keeps its own position.
+ * Any number of cursors can run along the consuming reader and the writer:
+ * consuming reads do not drag the cursors back to the reader page, and the
+ * writer is not disabled. Events the writer overwrote, or that the consumer
+ * took before the cursor got to them, are skipped and reported through
+ * ring_buffer_iter_dropped().
+ *
+ * Use ring_buffer_cursor_read() to read the events, and release the cursor
+ * with ring_buffer_read_finish().
+ */
+struct ring_buffer_iter *
+ring_buffer_cursor_open(struct trace_buffer *buffer, int cpu, gfp_t flags)
+{
+	struct ring_buffer_iter *iter;
+
+	iter = ring_buffer_read_prepare(buffer, cpu, flags);
+	if (!iter)
+		return NULL;
+
+	iter->cursor = true;
+	ring_buffer_read_prepare_sync();
+	ring_buffer_read_start(iter);
+
+	return iter;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_cursor_open);
+
+/**
+ * ring_buffer_cursor_read - read the next event and advance the cursor
+ * @iter: The cursor returned by ring_buffer_cursor_open()
+ * @ts: The timestamp counter of this event (may be NULL)
+ *
+ * Returns a copy of the next event, which stays valid until the next
+ * call on @iter, or NULL if the cursor caught up with the writer.
+ */
+struct ring_buffer_event *
+ring_buffer_cursor_read(struct ring_buffer_iter *iter, u64 *ts)
+{
+	struct ring_buffer_per_cpu *cpu_buffer = iter->cpu_buffer;
+	struct ring_buffer_event *event;
+	unsigned long flags;
+
+ again:
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	event = rb_iter_peek(iter, ts);
+	/* Padding events are already passed over by the peek */
+	if (event && event->type_len != RINGBUF_TYPE_PADDING)
+		rb_advance_iter(iter);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	if (event && event->type_len == RINGBUF_TYPE_PADDING)
+		goto again;
+
+	return event;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_cursor_read);
+
 /**
  * ring_buffer_iter_advance - advance the iterator to the next location
  * @iter: The ring buffer iterator
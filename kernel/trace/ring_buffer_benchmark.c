@@ -7,6 +7,8 @@
 #include <linux/ring_buffer.h>
 #include <linux/completion.h>
 #include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
 #include <uapi/linux/sched/types.h>
 #include <linux/module.h>
 #include <linux/ktime.h>
@@ -22,6 +24,9 @@ struct rb_page {
 #define RUN_TIME	10ULL
 #define SLEEP_TIME	10
 
+/* number of events a cursor thread reads between reschedule points */
+#define CURSOR_BATCH	100
+
 /* number of events for writer to wake up the reader */
 static int wakeup_interval = 100;
 
@@ -38,6 +43,10 @@ static unsigned int disable_reader;
 module_param(disable_reader, uint, 0644);
 MODULE_PARM_DESC(disable_reader, "only run producer");
 
+static unsigned int nr_cursors;
+module_param(nr_cursors, uint, 0644);
+MODULE_PARM_DESC(nr_cursors, "# of reader cursors running along the consumer");
+
 static unsigned int write_iteration = 50;
 module_param(write_iteration, uint, 0644);
 MODULE_PARM_DESC(write_iteration, "# of writes between timestamp readings");
@@ -227,6 +236,126 @@ static void ring_buffer_consumer(void)
 	complete(&read_done);
 }
 
+struct rb_cursor_reader {
+	struct task_struct	*task;
+	unsigned long		read;
+	unsigned long		dropped;
+};
+
+static struct rb_cursor_reader *cursor_readers;
+
+static void wait_to_die(void);
+
+/*
+ * Each cursor thread reads every cpu buffer through its own reader cursors
+ * while the producer and the consumer run, to see how much the writer is
+ * slowed down by several concurrent readers.
+ */
+static int ring_buffer_cursor_thread(void *arg)
+{
+	struct rb_cursor_reader *reader = arg;
+	struct ring_buffer_event *event;
+	struct ring_buffer_iter **iters;
+	unsigned int batch;
+	bool found;
+	int *entry;
+	int cpu;
+
+	iters = kcalloc(nr_cpu_ids, sizeof(*iters), GFP_KERNEL);
+	if (!iters) {
+		TEST_ERROR();
+		goto out;
+	}
+
+	for_each_online_cpu(cpu)
+		iters[cpu] = ring_buffer_cursor_open(buffer, cpu, GFP_KERNEL);
+
+	while (!break_test()) {
+		found = false;
+
+		for_each_online_cpu(cpu) {
+			if (!iters[cpu])
+				continue;
+
+			batch = 0;
+			while ((event = ring_buffer_cursor_read(iters[cpu], NULL))) {
+				entry = ring_buffer_event_data(event);
+				if (*entry != cpu) {
+					TEST_ERROR();
+					break;
+				}
+				reader->read++;
+				found = true;
+
+				/* the producer may keep this buffer from ever draining */
+				if (++batch % CURSOR_BATCH == 0)
+					cond_resched();
+			}
+
+			if (ring_buffer_iter_dropped(iters[cpu]))
+				reader->dropped++;
+		}
+
+		if (!found)
+			usleep_range(100, 200);
+		else
+			cond_resched();
+	}
+
+	for_each_online_cpu(cpu)
+		if (iters[cpu])
+			ring_buffer_read_finish(iters[cpu]);
+	kfree(iters);
+ out:
+	if (!kthread_should_stop())
+		wait_to_die();
+
+	return 0;
+}
+
+static void ring_buffer_start_cursors(void)
+{
+	int i;
+
+	if (!nr_cursors)
+		return;
+
+	cursor_readers = kcalloc(nr_cursors, sizeof(*cursor_readers),
+				 GFP_KERNEL);
+	if (!cursor_readers)
+		return;
+
+	for (i = 0; i < nr_cursors; i++) {
+		cursor_readers[i].task = kthread_run(ring_buffer_cursor_thread,
+						     &cursor_readers[i],
+						     "rb_cursor/%d", i);
+		if (IS_ERR(cursor_readers[i].task))
+			cursor_readers[i].task = NULL;
+		else
+			set_user_nice(cursor_readers[i].task, consumer_nice);
+	}
+}
+
+static void ring_buffer_stop_cursors(void)
+{
+	int i;
+
+	if (!cursor_readers)
+		return;
+
+	for (i = 0; i < nr_cursors; i++) {
+		if (!cursor_readers[i].task)
+			continue;
+		kthread_stop(cursor_readers[i].task);
+		trace_printk("Cursor %d read: %ld  dropped: %ld\n", i,
+			     cursor_readers[i].read,
+			     cursor_readers[i].dropped);
+	}
+
+	kfree(cursor_readers);
+	cursor_readers = NULL;
+}
+
 static void ring_buffer_producer(void)
 {
 	ktime_t start_time, end_time, timeout;
@@ -242,6 +371,8 @@ static void ring_buffer_producer(void)
 	 * Hammer the buffer for 10 secs (this may
 	 * make the system stall)
 	 */
+	ring_buffer_start_cursors();
+
 	trace_printk("Starting ring buffer hammer\n");
 	start_time = ktime_get();
 	timeout = ktime_add_ns(start_time, RUN_TIME * NSEC_PER_SEC);
@@ -283,6 +414,8 @@ static void ring_buffer_producer(void)
 	} while (ktime_before(end_time, timeout) && !break_test());
 	trace_printk("End ring buffer hammer\n");
 
+	ring_buffer_stop_cursors();
+
 	if (consumer) {
 		/* Init both completions here to avoid races */
 		init_completion(&read_start);
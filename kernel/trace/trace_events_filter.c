@@ -141,18 +141,58 @@ static bool is_not(const char *str)
 	return true;
 }
 
+/*
+ * Compiled form of the fixed size integer predicates, which is what most
+ * filters are made of. The opcode encodes both the field type and the
+ * comparison, and the program entry carries the field offset and the
+ * constant, so matching them takes a single dispatch without touching
+ * the filter_pred. Predicates that cannot depend on the event are folded
+ * into FILTER_INSN_TRUE/FILTER_INSN_FALSE. Anything else is left as
+ * FILTER_INSN_PRED and goes through filter_pred_fn_call().
+ */
+#define FILTER_INSN_SIZES(op)						\
+	FILTER_INSN_##op##_64, FILTER_INSN_##op##_32,			\
+	FILTER_INSN_##op##_16, FILTER_INSN_##op##_8
+
+#define FILTER_INSN_TYPES(op)						\
+	FILTER_INSN_##op##_S64, FILTER_INSN_##op##_U64,			\
+	FILTER_INSN_##op##_S32, FILTER_INSN_##op##_U32,			\
+	FILTER_INSN_##op##_S16, FILTER_INSN_##op##_U16,			\
+	FILTER_INSN_##op##_S8, FILTER_INSN_##op##_U8
+
+enum filter_insn {
+	FILTER_INSN_PRED,
+	FILTER_INSN_FALSE,
+	FILTER_INSN_TRUE,
+	FILTER_INSN_SIZES(EQ),
+	FILTER_INSN_SIZES(NE),
+	FILTER_INSN_TYPES(LT),
+	FILTER_INSN_TYPES(LE),
+	FILTER_INSN_TYPES(GT),
+	FILTER_INSN_TYPES(GE),
+	FILTER_INSN_TYPES(BAND),
+};
+
 /**
  * struct prog_entry - a singe entry in the filter program
  * @target:	     Index to jump to on a branch (actually one minus the index)
  * @when_to_branch:  The value of the result of the predicate to do a branch
  * @pred:	     The predicate to execute.
+ * @insn:	     The compiled predicate (enum filter_insn)
+ * @offset:	     Offset of the field in the event for @insn
+ * @val:	     Constant to compare the field against for @insn
  */
 struct prog_entry {
 	int			target;
 	int			when_to_branch;
 	struct filter_pred	*pred;
+	int			insn;
+	int			offset;
+	u64			val;
 };
 
+static void filter_compile_pred(struct prog_entry *entry);
+
 /**
  * update_preds - assign a program entry a label target
  * @prog: The program array
@@ -633,6 +673,7 @@ predicate_parse(const char *str, int nr_parens, int nr_preds,
 			ret = -EINVAL;
 			goto out_free;
 		}
+		filter_compile_pred(&prog[i]);
 	}
 
 	kfree(op_stack);
@@ -1167,6 +1208,140 @@ static int test_pred_visited_fn(struct filter_pred *pred, void *event)
 
 static int filter_pred_fn_call(struct filter_pred *pred, void *event);
 
+/* Index of the fixed size type in FILTER_INSN_TYPES(), or -1 */
+static int filter_insn_type(enum filter_pred_fn fn)
+{
+	switch (fn) {
+	case FILTER_PRED_FN_S64:	return 0;
+	case FILTER_PRED_FN_U64:	return 1;
+	case FILTER_PRED_FN_S32:	return 2;
+	case FILTER_PRED_FN_U32:	return 3;
+	case FILTER_PRED_FN_S16:	return 4;
+	case FILTER_PRED_FN_U16:	return 5;
+	case FILTER_PRED_FN_S8:		return 6;
+	case FILTER_PRED_FN_U8:		return 7;
+	default:			return -1;
+	}
+}
+
+static void filter_compile_pred(struct prog_entry *entry)
+{
+	struct filter_pred *pred = entry->pred;
+	int insn, type, size;
+	u64 val;
+
+	entry->insn = FILTER_INSN_PRED;
+	entry->offset = pred->offset;
+	entry->val = pred->val;
+
+	switch (pred->fn_num) {
+	case FILTER_PRED_FN_64:
+		insn = FILTER_INSN_EQ_64;
+		break;
+	case FILTER_PRED_FN_32:
+		insn = FILTER_INSN_EQ_32;
+		break;
+	case FILTER_PRED_FN_16:
+		insn = FILTER_INSN_EQ_16;
+		break;
+	case FILTER_PRED_FN_8:
+		insn = FILTER_INSN_EQ_8;
+		break;
+	default:
+		insn = -1;
+		break;
+	}
+
+	if (insn >= 0) {
+		if (pred->not)
+			insn += FILTER_INSN_NE_64 - FILTER_INSN_EQ_64;
+		entry->insn = insn;
+		return;
+	}
+
+	type = filter_insn_type(pred->fn_num);
+	if (type < 0)
+		return;
+
+	switch (pred->op) {
+	case OP_LT:
+		insn = FILTER_INSN_LT_S64;
+		break;
+	case OP_LE:
+		insn = FILTER_INSN_LE_S64;
+		break;
+	case OP_GT:
+		insn = FILTER_INSN_GT_S64;
+		break;
+	case OP_GE:
+		insn = FILTER_INSN_GE_S64;
+		break;
+	case OP_BAND:
+		insn = FILTER_INSN_BAND_S64;
+		break;
+	default:
+		return;
+	}
+	entry->insn = insn + type;
+
+	/* The predicates truncate the constant to the size of the field */
+	size = 8 >> (type / 2);
+	val = size == 8 ? pred->val : pred->val & ((1ULL << (size * 8)) - 1);
+
+	/* Fold the comparisons whose result does not depend on the field */
+	if (pred->op == OP_BAND && !val)
+		entry->insn = FILTER_INSN_FALSE;
+	else if ((type & 1) && !val && pred->op == OP_LT)
+		entry->insn = FILTER_INSN_FALSE;
+	else if ((type & 1) && !val && pred->op == OP_GE)
+		entry->insn = FILTER_INSN_TRUE;
+}
+
+#define FILTER_INSN_EVAL_EQ(size)					\
+	case FILTER_INSN_EQ_##size:					\
+		return *(u##size *)addr == (u##size)entry->val;		\
+	case FILTER_INSN_NE_##size:					\
+		return *(u##size *)addr != (u##size)entry->val;
+
+#define FILTER_INSN_EVAL_CMP(T, type)					\
+	case FILTER_INSN_LT_##T:					\
+		return *(type *)addr < (type)entry->val;		\
+	case FILTER_INSN_LE_##T:					\
+		return *(type *)addr <= (type)entry->val;		\
+	case FILTER_INSN_GT_##T:					\
+		return *(type *)addr > (type)entry->val;		\
+	case FILTER_INSN_GE_##T:					\
+		return *(type *)addr >= (type)entry->val;		\
+	case FILTER_INSN_BAND_##T:					\
+		return !!(*(type *)addr & (type)entry->val);
+
+static __always_inline int filter_insn_eval(struct prog_entry *entry,
+					    void *rec)
+{
+	void *addr = rec + entry->offset;
+
+	switch (entry->insn) {
+	case FILTER_INSN_FALSE:
+		return 0;
+	case FILTER_INSN_TRUE:
+		return 1;
+	FILTER_INSN_EVAL_EQ(64)
+	FILTER_INSN_EVAL_EQ(32)
+	FILTER_INSN_EVAL_EQ(16)
+	FILTER_INSN_EVAL_EQ(8)
+	FILTER_INSN_EVAL_CMP(S64, s64)
+	FILTER_INSN_EVAL_CMP(U64, u64)
+	FILTER_INSN_EVAL_CMP(S32, s32)
+	FILTER_INSN_EVAL_CMP(U32, u32)
+	FILTER_INSN_EVAL_CMP(S16, s16)
+	FILTER_INSN_EVAL_CMP(U16, u16)
+	FILTER_INSN_EVAL_CMP(S8, s8)
+	FILTER_INSN_EVAL_CMP(U8, u8)
+	default:
+		return filter_pred_fn_call(entry->pred, rec);
+	}
+}
+
 /* return 1 if event matches, 0 otherwise (discard) */
 int filter_match_preds(struct event_filter *filter, void *rec)
 {
@@ -1183,8 +1358,7 @@ int filter_match_preds(struct event_filter *filter, void *rec)
 		return 1;
 
 	for (i = 0; prog[i].pred; i++) {
-		struct filter_pred *pred = prog[i].pred;
-		int match = filter_pred_fn_call(pred, rec);
+		int match = filter_insn_eval(&prog[i], rec);
 		if (match == prog[i].when_to_branch)
 			i = prog[i].target;
 	}
@@ -2718,6 +2892,17 @@ static struct test_filter_data_t {
 	DATA_REC(YES, 1, 1, 1, 1, 1, 1, 1, 1, "bdfh"),
 	DATA_REC(YES, 0, 1, 0, 1, 0, 1, 0, 1, ""),
 	DATA_REC(YES, 1, 0, 1, 0, 1, 0, 1, 0, "bdfh"),
+#undef FILTER
+#define FILTER "a < 2 && b <= -1 && c > 0 && d >= 3 && (e & 6) && f != 1"
+	DATA_REC(YES, 1, -1, 1, 3, 2, 0, 0, 0, ""),
+	DATA_REC(NO,  2, -1, 1, 3, 2, 0, 0, 0, "bcdef"),
+	DATA_REC(NO,  1, -1, 1, 3, 1, 0, 0, 0, "f"),
+	DATA_REC(NO,  1, -1, 1, 3, 4, 1, 0, 0, ""),
+#undef FILTER
+#define FILTER "(a & 0) || b != 0 || (c > -2 && d < -2)"
+	DATA_REC(YES, 1, 1, 0, 0, 0, 0, 0, 0, "cd"),
+	DATA_REC(YES, 1, 0, -1, -3, 0, 0, 0, 0, ""),
+	DATA_REC(NO,  1, 0, -3, -3, 0, 0, 0, 0, "d"),
 };
 
 #undef DATA_REC
@@ -2759,9 +2944,24 @@ static void update_pred_fn(struct event_filter *filter, char *fields)
 			continue;
 
 		pred->fn_num = FILTER_PRED_TEST_VISITED;
+		prog[i].insn = FILTER_INSN_PRED;
 	}
 }
 
+/* Run the program through the predicates only, ignoring the compiled form */
+static int filter_match_preds_interp(struct event_filter *filter, void *rec)
+{
+	struct prog_entry *prog = rcu_dereference_raw(filter->prog);
+	int i;
+
+	for (i = 0; prog[i].pred; i++) {
+		int match = filter_pred_fn_call(prog[i].pred, rec);
+		if (match == prog[i].when_to_branch)
+			i = prog[i].target;
+	}
+	return prog[i].target;
+}
+
 static __init int ftrace_test_event_filter(void)
 {
 	int i;
@@ -2795,6 +2995,16 @@ static __init int ftrace_test_event_filter(void)
 
 		test_pred_visited = 0;
 		err = filter_match_preds(filter, &d->rec);
+		if (!test_pred_visited &&
+		    filter_match_preds_interp(filter, &d->rec) != err) {
+			preempt_enable();
+			mutex_unlock(&event_mutex);
+			__free_filter(filter);
+			printk(KERN_INFO
+			       "Failed, compiled filter '%s' does not match the predicates\n",
+			       d->filter);
+			break;
+		}
 		preempt_enable();
 
 		mutex_unlock(&event_mutex);
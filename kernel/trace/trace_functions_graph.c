@@ -12,6 +12,9 @@
 #include <linux/interrupt.h>
 #include <linux/slab.h>
 #include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -41,6 +44,37 @@ struct fgraph_data {
 
 unsigned int fgraph_max_depth;
 
+/*
+ * Sampling: when fgraph_sample_rate is N > 1, only one in N calls of a
+ * function starting a traced call tree is traced, along with everything
+ * it calls; the whole tree is skipped otherwise. Calls are counted per CPU,
+ * in buckets indexed by a hash of the function address.
+ *
+ * While fgraph_sample_rate is non zero, the durations of the traced
+ * functions are also accumulated in per CPU log2 histograms, read from
+ * the graph_latency_hist file.
+ */
+#define FGRAPH_SAMPLE_BITS	6
+#define FGRAPH_HIST_BITS	7
+#define FGRAPH_HIST_SLOTS	(1 << FGRAPH_HIST_BITS)
+#define FGRAPH_HIST_PROBES	4
+#define FGRAPH_HIST_BUCKETS	32
+
+struct fgraph_hist_slot {
+	unsigned long	func;
+	u32		count[FGRAPH_HIST_BUCKETS];
+};
+
+struct fgraph_hist {
+	struct fgraph_hist_slot	slots[FGRAPH_HIST_SLOTS];
+	u64			dropped;
+};
+
+static unsigned int fgraph_sample_rate;
+static DEFINE_PER_CPU(unsigned int [1 << FGRAPH_SAMPLE_BITS], fgraph_sample_cnt);
+static struct fgraph_hist __percpu *fgraph_hist;
+static DEFINE_MUTEX(fgraph_hist_lock);
+
 static struct tracer_opt trace_opts[] = {
 	/* Display overruns? (for self-debug purpose) */
 	{ TRACER_OPT(funcgraph-overrun, TRACE_GRAPH_PRINT_OVERRUN) },
@@ -129,6 +163,71 @@ static inline int ftrace_graph_ignore_irqs(void)
 	return in_hardirq();
 }
 
+static inline bool fgraph_sample_skip(struct ftrace_graph_ent *trace)
+{
+	unsigned int rate = READ_ONCE(fgraph_sample_rate);
+	unsigned int idx;
+
+	if (rate <= 1)
+		return false;
+
+	/*
+	 * Only sample the roots, never cut a traced call tree. With
+	 * set_graph_function, the root is the function that set
+	 * TRACE_GRAPH_BIT; otherwise it is the outermost traced function.
+	 */
+	if (trace_recursion_test(TRACE_GRAPH_BIT) ?
+	    trace_recursion_depth() != trace->depth : trace->depth)
+		return false;
+
+	idx = hash_ptr((void *)trace->func, FGRAPH_SAMPLE_BITS);
+	return this_cpu_inc_return(fgraph_sample_cnt[idx]) % rate;
+}
+
+static struct fgraph_hist_slot *
+fgraph_hist_find(struct fgraph_hist *hist, unsigned long func, bool insert)
+{
+	struct fgraph_hist_slot *slot;
+	unsigned int idx, i;
+
+	idx = hash_ptr((void *)func, FGRAPH_HIST_BITS);
+	for (i = 0; i < FGRAPH_HIST_PROBES; i++) {
+		slot = &hist->slots[(idx + i) & (FGRAPH_HIST_SLOTS - 1)];
+		if (slot->func == func)
+			return slot;
+		if (!slot->func) {
+			if (!insert)
+				return NULL;
+			slot->func = func;
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+/* Called with interrupts disabled */
+static void fgraph_hist_add(struct ftrace_graph_ret *trace)
+{
+	struct fgraph_hist *hist = READ_ONCE(fgraph_hist);
+	struct fgraph_hist_slot *slot;
+	u64 delta;
+
+	if (!hist || !READ_ONCE(fgraph_sample_rate))
+		return;
+
+	hist = this_cpu_ptr(hist);
+	slot = fgraph_hist_find(hist, trace->func, true);
+	if (!slot) {
+		hist->dropped++;
+		return;
+	}
+
+	delta = trace->rettime - trace->calltime;
+	slot->count[delta ? min_t(int, ilog2(delta),
+				  FGRAPH_HIST_BUCKETS - 1) : 0]++;
+}
+
 int trace_graph_entry(struct ftrace_graph_ent *trace)
 {
 	struct trace_array *tr = graph_array;
@@ -139,7 +238,8 @@ int trace_graph_entry(struct ftrace_graph_ent *trace)
 	int ret;
 	int cpu;
 
-	if (trace_recursion_test(TRACE_GRAPH_NOTRACE_BIT))
+	if (trace_recursion_test(TRACE_GRAPH_NOTRACE_BIT) ||
+	    trace_recursion_test(TRACE_GRAPH_SAMPLE_BIT))
 		return 0;
 
 	/*
@@ -167,6 +267,15 @@ int trace_graph_entry(struct ftrace_graph_ent *trace)
 	if (ftrace_graph_ignore_irqs())
 		return 0;
 
+	/*
+	 * Like set_graph_notrace, a sampled out root needs its return
+	 * called to clear the bit, and TRACE_GRAPH_BIT if it set it.
+	 */
+	if (fgraph_sample_skip(trace)) {
+		trace_recursion_set(TRACE_GRAPH_SAMPLE_BIT);
+		return 1;
+	}
+
 	/*
 	 * Stop here if tracing_threshold is set. We only write function return
 	 * events to the ring buffer.
@@ -254,6 +363,11 @@ void trace_graph_return(struct ftrace_graph_ret *trace)
 		return;
 	}
 
+	if (trace_recursion_test(TRACE_GRAPH_SAMPLE_BIT)) {
+		trace_recursion_clear(TRACE_GRAPH_SAMPLE_BIT);
+		return;
+	}
+
 	local_irq_save(flags);
 	cpu = raw_smp_processor_id();
 	data = per_cpu_ptr(tr->array_buffer.data, cpu);
@@ -261,6 +375,7 @@ void trace_graph_return(struct ftrace_graph_ret *trace)
 	if (likely(disabled == 1)) {
 		trace_ctx = tracing_gen_ctx_flags(flags);
 		__trace_graph_return(tr, trace, trace_ctx);
+		fgraph_hist_add(trace);
 	}
 	atomic_dec(&data->disabled);
 	local_irq_restore(flags);
@@ -284,10 +399,20 @@ static void trace_graph_thresh_return(struct ftrace_graph_ret *trace)
 		return;
 	}
 
+	if (trace_recursion_test(TRACE_GRAPH_SAMPLE_BIT)) {
+		trace_recursion_clear(TRACE_GRAPH_SAMPLE_BIT);
+		return;
+	}
+
 	if (tracing_thresh &&
-	    (trace->rettime - trace->calltime < tracing_thresh))
+	    (trace->rettime - trace->calltime < tracing_thresh)) {
+		unsigned long flags;
+
+		local_irq_save(flags);
+		fgraph_hist_add(trace);
+		local_irq_restore(flags);
 		return;
-	else
+	} else
 		trace_graph_return(trace);
 }
 
@@ -1405,6 +1530,179 @@ static const struct file_operations graph_depth_fops = {
 	.llseek		= generic_file_llseek,
 };
 
+static ssize_t
+graph_sample_write(struct file *filp, const char __user *ubuf, size_t cnt,
+		   loff_t *ppos)
+{
+	struct fgraph_hist __percpu *hist;
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&fgraph_hist_lock);
+	if (val && !fgraph_hist) {
+		hist = alloc_percpu(struct fgraph_hist);
+		if (!hist) {
+			mutex_unlock(&fgraph_hist_lock);
+			return -ENOMEM;
+		}
+		WRITE_ONCE(fgraph_hist, hist);
+	}
+	WRITE_ONCE(fgraph_sample_rate, val);
+	mutex_unlock(&fgraph_hist_lock);
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static ssize_t
+graph_sample_read(struct file *filp, char __user *ubuf, size_t cnt,
+		  loff_t *ppos)
+{
+	char buf[15]; /* More than enough to hold UINT_MAX + "\n"*/
+	int n;
+
+	n = sprintf(buf, "%u\n", fgraph_sample_rate);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, n);
+}
+
+static const struct file_operations graph_sample_fops = {
+	.open		= tracing_open_generic,
+	.write		= graph_sample_write,
+	.read		= graph_sample_read,
+	.llseek		= generic_file_llseek,
+};
+
+static int graph_hist_show(struct seq_file *m, void *v)
+{
+	struct fgraph_hist_slot *slot;
+	struct fgraph_hist *hist;
+	u64 count[FGRAPH_HIST_BUCKETS];
+	u64 dropped = 0, total;
+	unsigned long func;
+	int cpu, c, i, b;
+
+	mutex_lock(&fgraph_hist_lock);
+	if (!fgraph_hist)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		hist = per_cpu_ptr(fgraph_hist, cpu);
+		dropped += READ_ONCE(hist->dropped);
+
+		for (i = 0; i < FGRAPH_HIST_SLOTS; i++) {
+			func = READ_ONCE(hist->slots[i].func);
+			if (!func)
+				continue;
+
+			/* Already reported with a previous CPU? */
+			for_each_possible_cpu(c) {
+				if (c == cpu ||
+				    fgraph_hist_find(per_cpu_ptr(fgraph_hist, c),
+						     func, false))
+					break;
+			}
+			if (c != cpu)
+				continue;
+
+			memset(count, 0, sizeof(count));
+			for_each_possible_cpu(c) {
+				if (c < cpu)
+					continue;
+				slot = fgraph_hist_find(per_cpu_ptr(fgraph_hist, c),
+							func, false);
+				if (!slot)
+					continue;
+				for (b = 0; b < FGRAPH_HIST_BUCKETS; b++)
+					count[b] += READ_ONCE(slot->count[b]);
+			}
+
+			total = 0;
+			for (b = 0; b < FGRAPH_HIST_BUCKETS; b++)
+				total += count[b];
+			seq_printf(m, "%ps: %llu calls\n", (void *)func, total);
+			for (b = 0; b < FGRAPH_HIST_BUCKETS; b++) {
+				if (!count[b])
+					continue;
+				/* the last bucket also takes all longer calls */
+				if (b == FGRAPH_HIST_BUCKETS - 1)
+					seq_printf(m, "  >= %10llu ns: %llu\n",
+						   1ULL << b, count[b]);
+				else
+					seq_printf(m, "  %10llu - %10llu ns: %llu\n",
+						   b ? 1ULL << b : 0,
+						   (1ULL << (b + 1)) - 1, count[b]);
+			}
+		}
+	}
+	seq_printf(m, "dropped: %llu\n", dropped);
+out:
+	mutex_unlock(&fgraph_hist_lock);
+
+	return 0;
+}
+
+static int graph_hist_open(struct inode *inode, struct file *file)
+{
+	int ret;
+
+	ret = tracing_check_open_get_tr(NULL);
+	if (ret)
+		return ret;
+
+	return single_open(file, graph_hist_show, NULL);
+}
+
+/*
+ * fgraph_hist_add() updates the local histogram with interrupts disabled,
+ * so each CPU clears its own from an IPI to not race with it.
+ */
+static void fgraph_hist_reset_cpu(void *unused)
+{
+	memset(this_cpu_ptr(fgraph_hist), 0, sizeof(struct fgraph_hist));
+}
+
+/* Writing anything clears the histograms */
+static ssize_t
+graph_hist_write(struct file *filp, const char __user *ubuf, size_t cnt,
+		 loff_t *ppos)
+{
+	int cpu;
+
+	mutex_lock(&fgraph_hist_lock);
+	if (fgraph_hist) {
+		cpus_read_lock();
+		on_each_cpu(fgraph_hist_reset_cpu, NULL, 1);
+		for_each_possible_cpu(cpu) {
+			if (!cpu_online(cpu))
+				memset(per_cpu_ptr(fgraph_hist, cpu), 0,
+				       sizeof(struct fgraph_hist));
+		}
+		cpus_read_unlock();
+	}
+	mutex_unlock(&fgraph_hist_lock);
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static const struct file_operations graph_hist_fops = {
+	.open		= graph_hist_open,
+	.read		= seq_read,
+	.write		= graph_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static __init int init_graph_tracefs(void)
 {
 	int ret;
@@ -1415,6 +1713,10 @@ static __init int init_graph_tracefs(void)
 
 	trace_create_file("max_graph_depth", TRACE_MODE_WRITE, NULL,
 			  NULL, &graph_depth_fops);
+	trace_create_file("graph_sample_rate", TRACE_MODE_WRITE, NULL,
+			  NULL, &graph_sample_fops);
+	trace_create_file("graph_latency_hist", TRACE_MODE_WRITE, NULL,
+			  NULL, &graph_hist_fops);
 
 	return 0;
 }
@@ -16,6 +16,7 @@
 #include <linux/slab.h>
 #include <linux/sort.h>
 #include <linux/kmemleak.h>
+#include <asm/local64.h>
 
 #include "tracing_map.h"
 #include "trace.h"
@@ -26,6 +27,13 @@
  * of tracing_map data structures at the beginning of tracing_map.h.
  */
 
+static local64_t *tracing_map_elt_sums(struct tracing_map_elt *elt, int cpu)
+{
+	unsigned int idx = elt->idx;
+
+	return TRACING_MAP_ARRAY_ELT(elt->map->sums[cpu], idx);
+}
+
 /**
  * tracing_map_update_sum - Add a value to a tracing_map_elt's sum field
  * @elt: The tracing_map_elt
@@ -38,7 +46,16 @@
  */
 void tracing_map_update_sum(struct tracing_map_elt *elt, unsigned int i, u64 n)
 {
-	atomic64_add(n, &elt->fields[i].sum);
+	local64_t *sums;
+
+	/*
+	 * Sums are accumulated per CPU so that hist triggers on hot events
+	 * don't bounce the element between CPUs; they're folded on read.
+	 */
+	preempt_disable_notrace();
+	sums = tracing_map_elt_sums(elt, smp_processor_id());
+	local64_add(n, &sums[elt->map->sum_idx[i]]);
+	preempt_enable_notrace();
 }
 
 /**
@@ -55,7 +72,14 @@ void tracing_map_update_sum(struct tracing_map_elt *elt, unsigned int i, u64 n)
  */
 u64 tracing_map_read_sum(struct tracing_map_elt *elt, unsigned int i)
 {
-	return (u64)atomic64_read(&elt->fields[i].sum);
+	unsigned int sum_idx = elt->map->sum_idx[i];
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += local64_read(&tracing_map_elt_sums(elt, cpu)[sum_idx]);
+
+	return sum;
 }
 
 /**
@@ -226,7 +250,14 @@ static int tracing_map_add_field(struct tracing_map *map,
  */
 int tracing_map_add_sum_field(struct tracing_map *map)
 {
-	return tracing_map_add_field(map, tracing_map_cmp_atomic64);
+	int idx = tracing_map_add_field(map, tracing_map_cmp_atomic64);
+
+	if (idx < 0)
+		return idx;
+
+	map->sum_idx[idx] = map->n_sums++;
+
+	return idx;
 }
 
 /**
@@ -400,7 +431,8 @@ static void tracing_map_elt_free(struct tracing_map_elt *elt)
 	kfree(elt);
 }
 
-static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
+static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map,
+						     unsigned int idx)
 {
 	struct tracing_map_elt *elt;
 	int err = 0;
@@ -410,6 +442,7 @@ static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
 		return ERR_PTR(-ENOMEM);
 
 	elt->map = map;
+	elt->idx = idx;
 
 	elt->key = kzalloc(map->key_size, GFP_KERNEL);
 	if (!elt->key) {
@@ -490,7 +523,7 @@ static int tracing_map_alloc_elts(struct tracing_map *map)
 		return -ENOMEM;
 
 	for (i = 0; i < map->max_elts; i++) {
-		*(TRACING_MAP_ELT(map->elts, i)) = tracing_map_elt_alloc(map);
+		*(TRACING_MAP_ELT(map->elts, i)) = tracing_map_elt_alloc(map, i);
 		if (IS_ERR(*(TRACING_MAP_ELT(map->elts, i)))) {
 			*(TRACING_MAP_ELT(map->elts, i)) = NULL;
 			tracing_map_free_elts(map);
@@ -502,6 +535,41 @@ static int tracing_map_alloc_elts(struct tracing_map *map)
 	return 0;
 }
 
+static void tracing_map_free_sums(struct tracing_map *map)
+{
+	int cpu;
+
+	if (!map->sums)
+		return;
+
+	for_each_possible_cpu(cpu)
+		tracing_map_array_free(map->sums[cpu]);
+
+	kfree(map->sums);
+	map->sums = NULL;
+}
+
+static int tracing_map_alloc_sums(struct tracing_map *map)
+{
+	int cpu;
+
+	map->sums = kcalloc(nr_cpu_ids, sizeof(*map->sums), GFP_KERNEL);
+	if (!map->sums)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		map->sums[cpu] = tracing_map_array_alloc(map->max_elts,
+					max(map->n_sums, 1U) * sizeof(local64_t));
+		if (!map->sums[cpu]) {
+			tracing_map_free_sums(map);
+
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
 static inline bool keys_match(void *key, void *test_key, unsigned key_size)
 {
 	bool match = true;
@@ -679,6 +747,7 @@ void tracing_map_destroy(struct tracing_map *map)
 		return;
 
 	tracing_map_free_elts(map);
+	tracing_map_free_sums(map);
 
 	tracing_map_array_free(map->map);
 	kfree(map);
@@ -698,6 +767,7 @@ void tracing_map_destroy(struct tracing_map *map)
 void tracing_map_clear(struct tracing_map *map)
 {
 	unsigned int i;
+	int cpu;
 
 	atomic_set(&map->next_elt, -1);
 	atomic64_set(&map->hits, 0);
@@ -705,6 +775,9 @@ void tracing_map_clear(struct tracing_map *map)
 
 	tracing_map_array_clear(map->map);
 
+	for_each_possible_cpu(cpu)
+		tracing_map_array_clear(map->sums[cpu]);
+
 	for (i = 0; i < map->max_elts; i++)
 		tracing_map_elt_clear(*(TRACING_MAP_ELT(map->elts, i)));
 }
@@ -833,6 +906,10 @@ int tracing_map_init(struct tracing_map *map)
 	if (map->n_fields < 2)
 		return -EINVAL; /* need at least 1 key and 1 val */
 
+	err = tracing_map_alloc_sums(map);
+	if (err)
+		return err;
+
 	err = tracing_map_alloc_elts(map);
 	if (err)
 		return err;
@@ -948,11 +1025,27 @@ void tracing_map_destroy_sort_entries(struct tracing_map_sort_entry **entries,
 	vfree(entries);
 }
 
+/*
+ * Fold the per-CPU sums of @elt into the fields' sum, so that sorting
+ * compares a stable snapshot instead of walking all CPUs per comparison.
+ */
+static void tracing_map_elt_fold_sums(struct tracing_map_elt *elt)
+{
+	unsigned int i;
+
+	for (i = 0; i < elt->map->n_fields; i++)
+		if (elt->fields[i].cmp_fn == tracing_map_cmp_atomic64)
+			atomic64_set(&elt->fields[i].sum,
+				     tracing_map_read_sum(elt, i));
+}
+
 static struct tracing_map_sort_entry *
 create_sort_entry(void *key, struct tracing_map_elt *elt)
 {
 	struct tracing_map_sort_entry *sort_entry;
 
+	tracing_map_elt_fold_sums(elt);
+
 	sort_entry = kzalloc(sizeof(*sort_entry), GFP_KERNEL);
 	if (!sort_entry)
 		return NULL;
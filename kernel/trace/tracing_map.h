@@ -53,7 +53,10 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * 32-bit hashed key it's associated with.  Things such as the unique
  * set of aggregated sums associated with the 32-bit hashed key, along
  * with a copy of the full key associated with the entry, and which
- * was used to produce the 32-bit hashed key.
+ * was used to produce the 32-bit hashed key.  The sums themselves
+ * live in per-CPU arrays owned by the map (the sums field of struct
+ * tracing_map), indexed by the element's idx, so that updates never
+ * contend; they're only folded together when they're read or sorted.
  *
  * When tracing_map_create() is called to create the tracing map, the
  * user specifies (indirectly via the map_bits param, the details are
@@ -138,6 +141,7 @@ struct tracing_map_field {
 struct tracing_map_elt {
 	struct tracing_map		*map;
 	struct tracing_map_field	*fields;
+	unsigned int			idx;
 	atomic64_t			*vars;
 	bool				*var_set;
 	void				*key;
@@ -194,6 +198,9 @@ struct tracing_map {
 	unsigned int			n_fields;
 	int				key_idx[TRACING_MAP_KEYS_MAX];
 	unsigned int			n_keys;
+	int				sum_idx[TRACING_MAP_FIELDS_MAX];
+	unsigned int			n_sums;
+	struct tracing_map_array	**sums;
 	struct tracing_map_sort_key	sort_key;
 	unsigned int			n_vars;
 	atomic64_t			hits;
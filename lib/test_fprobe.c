@@ -5,6 +5,7 @@
 
 #include <linux/kernel.h>
 #include <linux/fprobe.h>
+#include <linux/ktime.h>
 #include <linux/random.h>
 #include <kunit/test.h>
 
@@ -232,6 +233,66 @@ static void test_fprobe_skip(struct kunit *test)
 	KUNIT_EXPECT_EQ(test, 0, unregister_fprobe(&fp));
 }
 
+#define BENCH_NR_FPROBES	16
+#define BENCH_LOOPS		100000
+
+static unsigned long bench_entries, bench_exits;
+
+static notrace int bench_entry_handler(struct fprobe *fp, unsigned long ip,
+				       unsigned long ret_ip,
+				       struct pt_regs *regs, void *data)
+{
+	bench_entries++;
+	return 0;
+}
+
+static notrace void bench_exit_handler(struct fprobe *fp, unsigned long ip,
+				       unsigned long ret_ip,
+				       struct pt_regs *regs, void *data)
+{
+	bench_exits++;
+}
+
+/* Throughput of many fprobes attached to the same function */
+static void test_fprobe_throughput(struct kunit *test)
+{
+	unsigned long nmissed = 0;
+	struct fprobe *fps;
+	u64 start, delta;
+	int i, nr = 0;
+
+	fps = kunit_kcalloc(test, BENCH_NR_FPROBES, sizeof(*fps), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, fps);
+
+	for (i = 0; i < BENCH_NR_FPROBES; i++) {
+		fps[i].entry_handler = bench_entry_handler;
+		fps[i].exit_handler = bench_exit_handler;
+		if (register_fprobe(&fps[i], "fprobe_selftest_target", NULL))
+			break;
+		nr++;
+	}
+	KUNIT_EXPECT_EQ(test, nr, BENCH_NR_FPROBES);
+
+	bench_entries = 0;
+	bench_exits = 0;
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_LOOPS; i++)
+		target(rand1);
+	delta = max_t(u64, ktime_get_ns() - start, 1);
+
+	for (i = 0; i < nr; i++) {
+		nmissed += fps[i].nmissed;
+		KUNIT_EXPECT_EQ(test, 0, unregister_fprobe(&fps[i]));
+	}
+
+	KUNIT_EXPECT_EQ(test, 0, nmissed);
+	KUNIT_EXPECT_EQ(test, (unsigned long)nr * BENCH_LOOPS, bench_entries);
+	KUNIT_EXPECT_EQ(test, bench_entries, bench_exits);
+	kunit_info(test, "%d fprobes: %llu ns per call, %llu hits/s\n", nr,
+		   div_u64(delta, BENCH_LOOPS),
+		   div64_u64((u64)bench_entries * NSEC_PER_SEC, delta));
+}
+
 static unsigned long get_ftrace_location(void *func)
 {
 	unsigned long size, addr = (unsigned long)func;
@@ -262,6 +323,7 @@ static struct kunit_case fprobe_testcases[] = {
 	KUNIT_CASE(test_fprobe_data),
 	KUNIT_CASE(test_fprobe_nest),
 	KUNIT_CASE(test_fprobe_skip),
+	KUNIT_CASE(test_fprobe_throughput),
 	{}
 };
 
@@ -0,0 +1,388 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Test module for stress and analyze scalability of zsmalloc allocator.
+ *
+ * All workers share one zs_pool, so running the module with nr_threads
+ * from 1 up to num_online_cpus() shows how alloc/free/map paths scale
+ * with the number of concurrent users of the pool.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/zsmalloc.h>
+#include <linux/random.h>
+#include <linux/kthread.h>
+#include <linux/moduleparam.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/rwsem.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+
+#define __param(type, name, init, msg)		\
+	static type name = init;				\
+	module_param(name, type, 0444);			\
+	MODULE_PARM_DESC(name, msg)				\
+
+__param(int, nr_threads, 0,
+	"Number of workers to perform tests(min: 1 max: USHRT_MAX)");
+
+__param(int, test_repeat_count, 1,
+	"Set test repeat counter");
+
+__param(int, test_loop_count, 100000,
+	"Set test loop counter");
+
+__param(int, nr_objs, 64,
+	"Number of objects each worker keeps allocated(min: 1)");
+
+__param(int, obj_size, 0,
+	"Object size for fix_size tests(default: PAGE_SIZE / 4)");
+
+__param(int, run_test_mask, INT_MAX,
+	"Set tests specified in the mask.\n\n"
+		"\t\tid: 1,    name: fix_size_alloc_free_test\n"
+		"\t\tid: 2,    name: random_size_alloc_free_test\n"
+		"\t\tid: 4,    name: alloc_map_free_test\n"
+		"\t\tid: 8,    name: map_only_test\n"
+		/* Add a new test case description here. */
+);
+
+static struct zs_pool *test_pool;
+
+/*
+ * Read write semaphore for synchronization of setup
+ * phase that is done in main thread and workers.
+ */
+static DECLARE_RWSEM(prepare_for_test_rwsem);
+
+/*
+ * Completion tracking for worker threads.
+ */
+static DECLARE_COMPLETION(test_all_done_comp);
+static atomic_t test_n_undone = ATOMIC_INIT(0);
+
+static inline void
+test_report_one_done(void)
+{
+	if (atomic_dec_and_test(&test_n_undone))
+		complete(&test_all_done_comp);
+}
+
+static size_t random_obj_size(void)
+{
+	return get_random_u32_inclusive(32, zs_huge_class_size(test_pool));
+}
+
+static void free_objs(unsigned long *handles, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		zs_free(test_pool, handles[i]);
+		handles[i] = 0;
+	}
+}
+
+static int alloc_free_test(bool random_size)
+{
+	unsigned long *handles;
+	int i, idx;
+
+	handles = kcalloc(nr_objs, sizeof(*handles), GFP_KERNEL);
+	if (!handles)
+		return -1;
+
+	for (i = 0; i < test_loop_count; i++) {
+		size_t size = random_size ? random_obj_size() : obj_size;
+
+		/*
+		 * Keep a window of nr_objs live objects, so the pool has
+		 * to both grow zspages and recycle freed slots.
+		 */
+		idx = i % nr_objs;
+		zs_free(test_pool, handles[idx]);
+		handles[idx] = zs_malloc(test_pool, size,
+					 GFP_KERNEL | __GFP_NOWARN);
+		if (IS_ERR_VALUE(handles[idx])) {
+			handles[idx] = 0;
+			free_objs(handles, nr_objs);
+			kfree(handles);
+			return -1;
+		}
+	}
+
+	free_objs(handles, nr_objs);
+	kfree(handles);
+
+	return 0;
+}
+
+static int fix_size_alloc_free_test(void)
+{
+	return alloc_free_test(false);
+}
+
+static int random_size_alloc_free_test(void)
+{
+	return alloc_free_test(true);
+}
+
+static int alloc_map_free_test(void)
+{
+	unsigned long handle;
+	void *dst;
+	int i;
+
+	for (i = 0; i < test_loop_count; i++) {
+		handle = zs_malloc(test_pool, obj_size,
+				   GFP_KERNEL | __GFP_NOWARN);
+		if (IS_ERR_VALUE(handle))
+			return -1;
+
+		dst = zs_map_object(test_pool, handle, ZS_MM_WO);
+		memset(dst, i, obj_size);
+		zs_unmap_object(test_pool, handle);
+
+		zs_free(test_pool, handle);
+	}
+
+	return 0;
+}
+
+static int map_only_test(void)
+{
+	unsigned long *handles;
+	int i, ret = 0;
+	u8 *src;
+
+	handles = kcalloc(nr_objs, sizeof(*handles), GFP_KERNEL);
+	if (!handles)
+		return -1;
+
+	for (i = 0; i < nr_objs; i++) {
+		handles[i] = zs_malloc(test_pool, obj_size,
+				       GFP_KERNEL | __GFP_NOWARN);
+		if (IS_ERR_VALUE(handles[i])) {
+			handles[i] = 0;
+			ret = -1;
+			goto out;
+		}
+
+		src = zs_map_object(test_pool, handles[i], ZS_MM_WO);
+		memset(src, i, obj_size);
+		zs_unmap_object(test_pool, handles[i]);
+	}
+
+	for (i = 0; i < test_loop_count; i++) {
+		int idx = i % nr_objs;
+
+		src = zs_map_object(test_pool, handles[idx], ZS_MM_RO);
+		if (src[obj_size - 1] != (u8)idx)
+			ret = -1;
+		zs_unmap_object(test_pool, handles[idx]);
+	}
+
+out:
+	free_objs(handles, nr_objs);
+	kfree(handles);
+
+	return ret;
+}
+
+struct test_case_desc {
+	const char *test_name;
+	int (*test_func)(void);
+};
+
+static struct test_case_desc test_case_array[] = {
+	{ "fix_size_alloc_free_test", fix_size_alloc_free_test },
+	{ "random_size_alloc_free_test", random_size_alloc_free_test },
+	{ "alloc_map_free_test", alloc_map_free_test },
+	{ "map_only_test", map_only_test },
+	/* Add a new test case here. */
+};
+
+struct test_case_data {
+	int test_failed;
+	int test_passed;
+	u64 time;
+};
+
+static struct test_driver {
+	struct task_struct *task;
+	struct test_case_data data[ARRAY_SIZE(test_case_array)];
+
+	unsigned long start;
+	unsigned long stop;
+} *tdriver;
+
+static int test_func(void *private)
+{
+	struct test_driver *t = private;
+	int index, j;
+	ktime_t kt;
+	u64 delta;
+
+	/*
+	 * Block until initialization is done.
+	 */
+	down_read(&prepare_for_test_rwsem);
+
+	t->start = get_cycles();
+	for (index = 0; index < ARRAY_SIZE(test_case_array); index++) {
+		/*
+		 * Skip tests if run_test_mask has been specified.
+		 */
+		if (!((run_test_mask & (1 << index)) >> index))
+			continue;
+
+		kt = ktime_get();
+		for (j = 0; j < test_repeat_count; j++) {
+			if (!test_case_array[index].test_func())
+				t->data[index].test_passed++;
+			else
+				t->data[index].test_failed++;
+		}
+
+		/*
+		 * Take an average time that test took.
+		 */
+		delta = (u64) ktime_us_delta(ktime_get(), kt);
+		do_div(delta, (u32) test_repeat_count);
+
+		t->data[index].time = delta;
+	}
+	t->stop = get_cycles();
+
+	up_read(&prepare_for_test_rwsem);
+	test_report_one_done();
+
+	/*
+	 * Wait for the kthread_stop() call.
+	 */
+	while (!kthread_should_stop())
+		msleep(10);
+
+	return 0;
+}
+
+static int
+init_test_configuration(void)
+{
+	nr_threads = clamp(nr_threads, 1, (int) USHRT_MAX);
+
+	if (test_repeat_count <= 0)
+		test_repeat_count = 1;
+
+	if (test_loop_count <= 0)
+		test_loop_count = 1;
+
+	if (nr_objs <= 0)
+		nr_objs = 1;
+
+	test_pool = zs_create_pool("zs_test");
+	if (!test_pool)
+		return -1;
+
+	if (obj_size <= 0 || obj_size > zs_huge_class_size(test_pool))
+		obj_size = PAGE_SIZE / 4;
+
+	/* Allocate the space for test instances. */
+	tdriver = kvcalloc(nr_threads, sizeof(*tdriver), GFP_KERNEL);
+	if (tdriver == NULL) {
+		zs_destroy_pool(test_pool);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void do_concurrent_test(void)
+{
+	u64 loops_per_sec;
+	int i, ret;
+
+	/*
+	 * Set some basic configurations plus sanity check.
+	 */
+	ret = init_test_configuration();
+	if (ret < 0)
+		return;
+
+	/*
+	 * Put on hold all workers.
+	 */
+	down_write(&prepare_for_test_rwsem);
+
+	for (i = 0; i < nr_threads; i++) {
+		struct test_driver *t = &tdriver[i];
+
+		t->task = kthread_run(test_func, t, "zsmalloc_test/%d", i);
+
+		if (!IS_ERR(t->task))
+			/* Success. */
+			atomic_inc(&test_n_undone);
+		else
+			pr_err("Failed to start %d kthread\n", i);
+	}
+
+	/*
+	 * Now let the workers do their job.
+	 */
+	up_write(&prepare_for_test_rwsem);
+
+	do {
+		ret = wait_for_completion_timeout(&test_all_done_comp, HZ);
+	} while (!ret);
+
+	for (i = 0; i < nr_threads; i++) {
+		struct test_driver *t = &tdriver[i];
+		int j;
+
+		if (!IS_ERR(t->task))
+			kthread_stop(t->task);
+
+		for (j = 0; j < ARRAY_SIZE(test_case_array); j++) {
+			if (!((run_test_mask & (1 << j)) >> j))
+				continue;
+
+			loops_per_sec = (u64)test_loop_count * USEC_PER_SEC;
+			do_div(loops_per_sec, max_t(u64, t->data[j].time, 1));
+
+			pr_info(
+				"Summary: %s passed: %d failed: %d repeat: %d loops: %d avg: %llu usec (%llu loops/sec)\n",
+				test_case_array[j].test_name,
+				t->data[j].test_passed,
+				t->data[j].test_failed,
+				test_repeat_count, test_loop_count,
+				t->data[j].time, loops_per_sec);
+		}
+
+		pr_info("All test took worker%d=%lu cycles\n",
+			i, t->stop - t->start);
+	}
+
+	pr_info("Pool used %lu pages, %d workers\n",
+		zs_get_total_pages(test_pool), nr_threads);
+
+	kvfree(tdriver);
+	zs_destroy_pool(test_pool);
+}
+
+static int zsmalloc_test_init(void)
+{
+	do_concurrent_test();
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void zsmalloc_test_exit(void)
+{
+}
+
+module_init(zsmalloc_test_init)
+module_exit(zsmalloc_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zsmalloc test module");
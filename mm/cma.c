@@ -34,6 +34,8 @@
 #include <linux/kmemleak.h>
 #include <linux/sched.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 #include <trace/events/cma.h>
 
 #include "internal.h"
@@ -43,6 +45,17 @@ struct cma cma_areas[MAX_CMA_AREAS];
 unsigned cma_area_count;
 static DEFINE_MUTEX(cma_mutex);
 
+/* How long a pageblock found busy is skipped by new allocations */
+#define CMA_BUSY_EXPIRE		msecs_to_jiffies(1000)
+
+/*
+ * Ranges of at least two chunks are migrated by up to CMA_MAX_PARALLEL
+ * workers, each handling a MAX_ORDER aligned part of the range one chunk
+ * at a time, so that a fatal signal to the caller is noticed in between.
+ */
+#define CMA_PARALLEL_CHUNK_PAGES	(2 * MAX_ORDER_NR_PAGES)
+#define CMA_MAX_PARALLEL		8
+
 phys_addr_t cma_get_base(const struct cma *cma)
 {
 	return PFN_PHYS(cma->base_pfn);
@@ -107,6 +120,11 @@ static void __init cma_activate_area(struct cma *cma)
 	if (!cma->bitmap)
 		goto out_error;
 
+	/* Only a hint, CMA works without it */
+	cma->busy_bitmap = bitmap_zalloc(DIV_ROUND_UP(cma->count,
+						      pageblock_nr_pages),
+					 GFP_KERNEL);
+
 	/*
 	 * alloc_contig_range() requires the pfn range specified to be in the
 	 * same zone. Simplify by forcing the entire CMA resv range to be in the
@@ -134,6 +152,7 @@ static void __init cma_activate_area(struct cma *cma)
 	return;
 
 not_in_zone:
+	bitmap_free(cma->busy_bitmap);
 	bitmap_free(cma->bitmap);
 out_error:
 	/* Expose all pages to the buddy, they are useless for CMA. */
@@ -420,6 +439,196 @@ static void cma_debug_show_areas(struct cma *cma)
 static inline void cma_debug_show_areas(struct cma *cma) { }
 #endif
 
+/*
+ * Racy check whether [pfn, end) holds a page that migration is unlikely
+ * to move soon, e.g. a pinned or unmovable kernel page. Only used as a
+ * hint, so no locking is done.
+ */
+static bool cma_range_has_unmovable(unsigned long pfn, unsigned long end)
+{
+	struct page *page;
+
+	for (; pfn < end; pfn++) {
+		page = pfn_to_page(pfn);
+
+		if (PageBuddy(page)) {
+			unsigned int order = buddy_order_unsafe(page);
+
+			if (order <= MAX_ORDER)
+				pfn += (1UL << order) - 1;
+			continue;
+		}
+
+		if (!page_count(page))
+			continue;
+
+		if (PageLRU(page)) {
+			if (folio_maybe_dma_pinned(page_folio(page)))
+				return true;
+			continue;
+		}
+
+		if (__PageMovable(page))
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Remember the pageblocks of a range that failed with -EBUSY, so that
+ * following allocations try other parts of the area first instead of
+ * retrying migration of the same pinned pages.
+ */
+static void cma_mark_busy(struct cma *cma, unsigned long pfn,
+			  unsigned long count)
+{
+	unsigned long end = pfn + count;
+	unsigned long block, flags;
+
+	if (!cma->busy_bitmap)
+		return;
+
+	pfn = ALIGN_DOWN(pfn, pageblock_nr_pages);
+	for (; pfn < end; pfn += pageblock_nr_pages) {
+		if (!cma_range_has_unmovable(max(pfn, cma->base_pfn),
+				min(pfn + pageblock_nr_pages, end)))
+			continue;
+
+		block = (pfn - cma->base_pfn) / pageblock_nr_pages;
+		spin_lock_irqsave(&cma->lock, flags);
+		set_bit(block, cma->busy_bitmap);
+		cma->busy_expires = jiffies + CMA_BUSY_EXPIRE;
+		spin_unlock_irqrestore(&cma->lock, flags);
+	}
+}
+
+/*
+ * Return the bitmap index to restart the search from if the candidate
+ * area overlaps a busy pageblock, or 0 if the area looks usable.
+ * Called with cma->lock held.
+ */
+static unsigned long cma_busy_skip(struct cma *cma, unsigned long bitmap_no,
+				   unsigned long bitmap_count)
+{
+	unsigned long off = bitmap_no << cma->order_per_bit;
+	unsigned long nr = bitmap_count << cma->order_per_bit;
+	unsigned long first, last, block;
+
+	if (time_after(jiffies, cma->busy_expires)) {
+		bitmap_zero(cma->busy_bitmap,
+			    DIV_ROUND_UP(cma->count, pageblock_nr_pages));
+		return 0;
+	}
+
+	first = off / pageblock_nr_pages;
+	last = (off + nr - 1) / pageblock_nr_pages;
+	block = find_next_bit(cma->busy_bitmap, last + 1, first);
+	if (block > last)
+		return 0;
+
+	return DIV_ROUND_UP((block + 1) * pageblock_nr_pages,
+			    1UL << cma->order_per_bit);
+}
+
+struct cma_range_work {
+	struct work_struct work;
+	unsigned long start;
+	unsigned long end;
+	gfp_t gfp_mask;
+	/* The task in cma_alloc(), whose fatal signals cancel the work */
+	struct task_struct *task;
+	/* Set by the first worker to fail, shared by all of them */
+	atomic_t *abort;
+	int ret;
+};
+
+static void cma_range_workfn(struct work_struct *work)
+{
+	struct cma_range_work *rw = container_of(work, struct cma_range_work,
+						 work);
+	unsigned long pfn, next;
+
+	for (pfn = rw->start; pfn < rw->end; pfn = next) {
+		if (atomic_read(rw->abort) || fatal_signal_pending(rw->task)) {
+			rw->ret = -EINTR;
+			break;
+		}
+
+		next = min(ALIGN(pfn + CMA_PARALLEL_CHUNK_PAGES,
+				 MAX_ORDER_NR_PAGES), rw->end);
+		rw->ret = alloc_contig_range(pfn, next, MIGRATE_CMA,
+					     rw->gfp_mask);
+		if (rw->ret) {
+			atomic_set(rw->abort, 1);
+			break;
+		}
+	}
+
+	/* On failure, leave nothing of this part allocated */
+	if (rw->ret && pfn > rw->start)
+		free_contig_range(rw->start, pfn - rw->start);
+}
+
+/*
+ * Migrate a large range with several workers. The range is cut at
+ * MAX_ORDER boundaries, so the pieces never share a pageblock and can
+ * be isolated independently. Called with cma_mutex held.
+ */
+static int cma_alloc_contig_range(struct cma *cma, unsigned long pfn,
+				  unsigned long count, gfp_t gfp_mask)
+{
+	struct cma_range_work works[CMA_MAX_PARALLEL];
+	atomic_t abort = ATOMIC_INIT(0);
+	unsigned long end = pfn + count;
+	unsigned long start, chunk;
+	int nr_works, i, ret = 0;
+
+	nr_works = min_t(unsigned long,
+			 min_t(unsigned int, num_online_cpus(), CMA_MAX_PARALLEL),
+			 count / CMA_PARALLEL_CHUNK_PAGES);
+	if (nr_works < 2)
+		return alloc_contig_range(pfn, end, MIGRATE_CMA, gfp_mask);
+
+	chunk = ALIGN(DIV_ROUND_UP(count, nr_works), MAX_ORDER_NR_PAGES);
+	for (i = 0, start = pfn; i < nr_works && start < end; i++) {
+		works[i].start = start;
+		works[i].end = min(ALIGN(start + chunk, MAX_ORDER_NR_PAGES), end);
+		works[i].gfp_mask = gfp_mask;
+		works[i].task = current;
+		works[i].abort = &abort;
+		works[i].ret = 0;
+		INIT_WORK_ONSTACK(&works[i].work, cma_range_workfn);
+		start = works[i].end;
+	}
+	nr_works = i;
+
+	for (i = 1; i < nr_works; i++)
+		queue_work(system_unbound_wq, &works[i].work);
+	cma_range_workfn(&works[0].work);
+
+	for (i = 0; i < nr_works; i++) {
+		if (i)
+			flush_work(&works[i].work);
+		destroy_work_on_stack(&works[i].work);
+		/* Report why the range failed, not that the others gave up */
+		if (works[i].ret && (!ret || ret == -EINTR))
+			ret = works[i].ret;
+	}
+
+	if (ret) {
+		for (i = 0; i < nr_works; i++) {
+			if (!works[i].ret)
+				free_contig_range(works[i].start,
+						  works[i].end - works[i].start);
+		}
+	}
+
+	return ret;
+}
+
 /**
  * __cma_alloc() - allocate pages from contiguous area
  * @cma:   Contiguous memory region for which the allocation is performed.
@@ -443,6 +652,8 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 	int ret = -ENOMEM;
 	int num_attempts = 0;
 	int max_retries = 5;
+	bool skip_busy = cma && cma->busy_bitmap;
+	ktime_t ts;
 
 	if (WARN_ON_ONCE((gfp_mask & GFP_KERNEL) == 0 ||
 		(gfp_mask & ~(GFP_KERNEL|__GFP_NOWARN|__GFP_NORETRY)) != 0))
@@ -458,6 +669,7 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 		goto out;
 
 	trace_cma_alloc_start(cma->name, count, align);
+	ts = ktime_get();
 
 	mask = cma_bitmap_aligned_mask(cma, align);
 	offset = cma_bitmap_aligned_offset(cma, align);
@@ -472,6 +684,13 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 		bitmap_no = bitmap_find_next_zero_area_off(cma->bitmap,
 				bitmap_maxno, start, bitmap_count, mask,
 				offset);
+		if (bitmap_no >= bitmap_maxno && skip_busy) {
+			/* Busy hints left no room, look at the whole area */
+			spin_unlock_irq(&cma->lock);
+			skip_busy = false;
+			start = 0;
+			continue;
+		}
 		if (bitmap_no >= bitmap_maxno) {
 			if ((num_attempts < max_retries) && (ret == -EBUSY)) {
 				spin_unlock_irq(&cma->lock);
@@ -489,6 +708,7 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 				 */
 				start = 0;
 				ret = -ENOMEM;
+				skip_busy = !!cma->busy_bitmap;
 				schedule_timeout_killable(msecs_to_jiffies(100));
 				num_attempts++;
 				continue;
@@ -497,6 +717,16 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 				break;
 			}
 		}
+		if (skip_busy) {
+			unsigned long next = cma_busy_skip(cma, bitmap_no,
+							   bitmap_count);
+
+			if (next) {
+				spin_unlock_irq(&cma->lock);
+				start = next;
+				continue;
+			}
+		}
 		bitmap_set(cma->bitmap, bitmap_no, bitmap_count);
 		/*
 		 * It's safe to drop the lock here. We've marked this region for
@@ -507,7 +737,7 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 
 		pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
 		mutex_lock(&cma_mutex);
-		ret = alloc_contig_range(pfn, pfn + count, MIGRATE_CMA, gfp_mask);
+		ret = cma_alloc_contig_range(cma, pfn, count, gfp_mask);
 		mutex_unlock(&cma_mutex);
 		if (ret == 0) {
 			page = pfn_to_page(pfn);
@@ -518,6 +748,8 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 		if (ret != -EBUSY)
 			break;
 
+		cma_mark_busy(cma, pfn, count);
+
 		pr_debug("%s(): memory range at pfn 0x%lx %p is busy, retrying\n",
 			 __func__, pfn, pfn_to_page(pfn));
 
@@ -527,6 +759,7 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 		start = bitmap_no + mask + 1;
 	}
 
+	cma_debug_account_latency(cma, ktime_us_delta(ktime_get(), ts));
 	trace_cma_alloc_finish(cma->name, pfn, page, count, align, ret);
 
 	/*
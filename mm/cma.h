@@ -5,6 +5,9 @@
 #include <linux/debugfs.h>
 #include <linux/kobject.h>
 
+/* Allocation latency buckets: < 1, 4, 16, 64, 256, 1024 ms and above */
+#define CMA_LATENCY_BUCKETS	7
+
 struct cma_kobject {
 	struct kobject kobj;
 	struct cma *cma;
@@ -16,10 +19,18 @@ struct cma {
 	unsigned long   *bitmap;
 	unsigned int order_per_bit; /* Order of pages represented by one bit */
 	spinlock_t	lock;
+	/*
+	 * One bit per pageblock recently found to hold pinned or unmovable
+	 * pages. Allocations skip these until busy_expires. Protected by lock.
+	 */
+	unsigned long	*busy_bitmap;
+	unsigned long	busy_expires;
 #ifdef CONFIG_CMA_DEBUGFS
 	struct hlist_head mem_head;
 	spinlock_t mem_head_lock;
 	struct debugfs_u32_array dfs_bitmap;
+	/* histogram of cma_alloc() latencies */
+	atomic64_t alloc_latency[CMA_LATENCY_BUCKETS];
 #endif
 	char name[CMA_MAX_NAME];
 #ifdef CONFIG_CMA_SYSFS
@@ -50,4 +61,10 @@ static inline void cma_sysfs_account_success_pages(struct cma *cma,
 static inline void cma_sysfs_account_fail_pages(struct cma *cma,
 						unsigned long nr_pages) {};
 #endif
+
+#ifdef CONFIG_CMA_DEBUGFS
+void cma_debug_account_latency(struct cma *cma, s64 us);
+#else
+static inline void cma_debug_account_latency(struct cma *cma, s64 us) {};
+#endif
 #endif
@@ -12,6 +12,7 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/mm_types.h>
+#include <linux/seq_file.h>
 
 #include "cma.h"
 
@@ -160,6 +161,37 @@ static int cma_alloc_write(void *data, u64 val)
 }
 DEFINE_DEBUGFS_ATTRIBUTE(cma_alloc_fops, NULL, cma_alloc_write, "%llu\n");
 
+/* Upper bound in ms of each latency bucket but the last one */
+static const unsigned int cma_latency_ms[CMA_LATENCY_BUCKETS - 1] = {
+	1, 4, 16, 64, 256, 1024,
+};
+
+void cma_debug_account_latency(struct cma *cma, s64 us)
+{
+	int i;
+
+	for (i = 0; i < CMA_LATENCY_BUCKETS - 1; i++) {
+		if (us < cma_latency_ms[i] * USEC_PER_MSEC)
+			break;
+	}
+	atomic64_inc(&cma->alloc_latency[i]);
+}
+
+static int cma_alloc_latency_show(struct seq_file *m, void *v)
+{
+	struct cma *cma = m->private;
+	int i;
+
+	for (i = 0; i < CMA_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, "<%ums %llu\n", cma_latency_ms[i],
+			   atomic64_read(&cma->alloc_latency[i]));
+	seq_printf(m, ">=%ums %llu\n", cma_latency_ms[i - 1],
+		   atomic64_read(&cma->alloc_latency[i]));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(cma_alloc_latency);
+
 static void cma_debugfs_add_one(struct cma *cma, struct dentry *root_dentry)
 {
 	struct dentry *tmp;
@@ -175,6 +207,8 @@ static void cma_debugfs_add_one(struct cma *cma, struct dentry *root_dentry)
 			    &cma->order_per_bit, &cma_debugfs_fops);
 	debugfs_create_file("used", 0444, tmp, cma, &cma_used_fops);
 	debugfs_create_file("maxchunk", 0444, tmp, cma, &cma_maxchunk_fops);
+	debugfs_create_file("alloc_latency", 0444, tmp, cma,
+			    &cma_alloc_latency_fops);
 
 	cma->dfs_bitmap.array = (u32 *)cma->bitmap;
 	cma->dfs_bitmap.n_elements = DIV_ROUND_UP(cma_bitmap_maxno(cma),
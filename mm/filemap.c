@@ -3205,6 +3205,8 @@ static struct file *do_sync_mmap_readahead(struct vm_fault *vmf)
 	if (!ra->ra_pages)
 		return fpin;
 
+	fpin = page_cache_ra_replay(vmf, fpin);
+
 	if (vm_flags & VM_SEQ_READ) {
 		fpin = maybe_unlock_mmap_for_io(vmf, fpin);
 		page_cache_sync_ra(&ractl, ra->ra_pages);
@@ -3314,6 +3316,7 @@ vm_fault_t filemap_fault(struct vm_fault *vmf)
 		 * We found the page, so try async readahead before waiting for
 		 * the lock.
 		 */
+		page_cache_ra_record(file, index);
 		if (!(vmf->flags & FAULT_FLAG_TRIED))
 			fpin = do_async_mmap_readahead(vmf, folio);
 		if (unlikely(!folio_test_uptodate(folio))) {
@@ -3605,6 +3608,8 @@ vm_fault_t filemap_map_pages(struct vm_fault *vmf,
 	vm_fault_t ret = 0;
 	unsigned int nr_pages = 0, mmap_miss = 0, mmap_miss_saved;
 
+	page_cache_ra_record(file, vmf->pgoff);
+
 	rcu_read_lock();
 	folio = next_uptodate_folio(&xas, mapping, end_pgoff);
 	if (!folio)
@@ -2339,13 +2339,17 @@ long get_user_pages_remote(struct mm_struct *mm,
 {
 	int local_locked = 1;
 
+	long ret;
+
 	if (!is_valid_gup_args(pages, locked, &gup_flags,
 			       FOLL_TOUCH | FOLL_REMOTE))
 		return -EINVAL;
 
-	return __get_user_pages_locked(mm, start, nr_pages, pages,
-				       locked ? locked : &local_locked,
-				       gup_flags);
+	ret = __get_user_pages_locked(mm, start, nr_pages, pages,
+				      locked ? locked : &local_locked,
+				      gup_flags);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL(get_user_pages_remote);
 
@@ -2377,12 +2381,15 @@ long get_user_pages(unsigned long start, unsigned long nr_pages,
 		    unsigned int gup_flags, struct page **pages)
 {
 	int locked = 1;
+	long ret;
 
 	if (!is_valid_gup_args(pages, NULL, &gup_flags, FOLL_TOUCH))
 		return -EINVAL;
 
-	return __get_user_pages_locked(current->mm, start, nr_pages, pages,
-				       &locked, gup_flags);
+	ret = __get_user_pages_locked(current->mm, start, nr_pages, pages,
+				      &locked, gup_flags);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL(get_user_pages);
 
@@ -2405,13 +2412,16 @@ long get_user_pages_unlocked(unsigned long start, unsigned long nr_pages,
 			     struct page **pages, unsigned int gup_flags)
 {
 	int locked = 0;
+	long ret;
 
 	if (!is_valid_gup_args(pages, NULL, &gup_flags,
 			       FOLL_TOUCH | FOLL_UNLOCKABLE))
 		return -EINVAL;
 
-	return __get_user_pages_locked(current->mm, start, nr_pages, pages,
-				       &locked, gup_flags);
+	ret = __get_user_pages_locked(current->mm, start, nr_pages, pages,
+				      &locked, gup_flags);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL(get_user_pages_unlocked);
 
@@ -3252,11 +3262,15 @@ int get_user_pages_fast_only(unsigned long start, int nr_pages,
 	 * FOLL_FAST_ONLY is required in order to match the API description of
 	 * this routine: no fall back to regular ("slow") GUP.
 	 */
+	int ret;
+
 	if (!is_valid_gup_args(pages, NULL, &gup_flags,
 			       FOLL_GET | FOLL_FAST_ONLY))
 		return -EINVAL;
 
-	return internal_get_user_pages_fast(start, nr_pages, gup_flags, pages);
+	ret = internal_get_user_pages_fast(start, nr_pages, gup_flags, pages);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(get_user_pages_fast_only);
 
@@ -3285,9 +3299,13 @@ int get_user_pages_fast(unsigned long start, int nr_pages,
 	 * FOLL_GET, because gup fast is always a "pin with a +1 page refcount"
 	 * request.
 	 */
+	int ret;
+
 	if (!is_valid_gup_args(pages, NULL, &gup_flags, FOLL_GET))
 		return -EINVAL;
-	return internal_get_user_pages_fast(start, nr_pages, gup_flags, pages);
+	ret = internal_get_user_pages_fast(start, nr_pages, gup_flags, pages);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(get_user_pages_fast);
 
@@ -3313,9 +3331,13 @@ EXPORT_SYMBOL_GPL(get_user_pages_fast);
 int pin_user_pages_fast(unsigned long start, int nr_pages,
 			unsigned int gup_flags, struct page **pages)
 {
+	int ret;
+
 	if (!is_valid_gup_args(pages, NULL, &gup_flags, FOLL_PIN))
 		return -EINVAL;
-	return internal_get_user_pages_fast(start, nr_pages, gup_flags, pages);
+	ret = internal_get_user_pages_fast(start, nr_pages, gup_flags, pages);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(pin_user_pages_fast);
 
@@ -3348,13 +3370,16 @@ long pin_user_pages_remote(struct mm_struct *mm,
 			   int *locked)
 {
 	int local_locked = 1;
+	long ret;
 
 	if (!is_valid_gup_args(pages, locked, &gup_flags,
 			       FOLL_PIN | FOLL_TOUCH | FOLL_REMOTE))
 		return 0;
-	return __gup_longterm_locked(mm, start, nr_pages, pages,
-				     locked ? locked : &local_locked,
-				     gup_flags);
+	ret = __gup_longterm_locked(mm, start, nr_pages, pages,
+				    locked ? locked : &local_locked,
+				    gup_flags);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL(pin_user_pages_remote);
 
@@ -3380,11 +3405,14 @@ long pin_user_pages(unsigned long start, unsigned long nr_pages,
 		    unsigned int gup_flags, struct page **pages)
 {
 	int locked = 1;
+	long ret;
 
 	if (!is_valid_gup_args(pages, NULL, &gup_flags, FOLL_PIN))
 		return 0;
-	return __gup_longterm_locked(current->mm, start, nr_pages,
-				     pages, &locked, gup_flags);
+	ret = __gup_longterm_locked(current->mm, start, nr_pages,
+				    pages, &locked, gup_flags);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL(pin_user_pages);
 
@@ -3400,12 +3428,15 @@ long pin_user_pages_unlocked(unsigned long start, unsigned long nr_pages,
 			     struct page **pages, unsigned int gup_flags)
 {
 	int locked = 0;
+	long ret;
 
 	if (!is_valid_gup_args(pages, NULL, &gup_flags,
 			       FOLL_PIN | FOLL_TOUCH | FOLL_UNLOCKABLE))
 		return 0;
 
-	return __gup_longterm_locked(current->mm, start, nr_pages, pages,
-				     &locked, gup_flags);
+	ret = __gup_longterm_locked(current->mm, start, nr_pages, pages,
+				    &locked, gup_flags);
+	page_pinner_record_pin(pages, ret, _RET_IP_);
+	return ret;
 }
 EXPORT_SYMBOL(pin_user_pages_unlocked);
@@ -328,6 +328,8 @@ void unmap_page_range(struct mmu_gather *tlb,
 void page_cache_ra_order(struct readahead_control *, struct file_ra_state *,
 		unsigned int order);
 void force_page_cache_ra(struct readahead_control *, unsigned long nr);
+void page_cache_ra_record(struct file *file, pgoff_t index);
+struct file *page_cache_ra_replay(struct vm_fault *vmf, struct file *fpin);
 static inline void force_page_cache_readahead(struct address_space *mapping,
 		struct file *file, pgoff_t index, unsigned long nr_to_read)
 {
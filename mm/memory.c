@@ -46,6 +46,7 @@
 #include <linux/sched/coredump.h>
 #include <linux/sched/numa_balancing.h>
 #include <linux/sched/task.h>
+#include <linux/sched/clock.h>
 #include <linux/hugetlb.h>
 #include <linux/mman.h>
 #include <linux/swap.h>
@@ -3213,6 +3214,7 @@ static inline vm_fault_t vmf_can_call_fault(const struct vm_fault *vmf)
 
 	if (vma->vm_ops->map_pages || !(vmf->flags & FAULT_FLAG_VMA_LOCK))
 		return 0;
+	count_vma_lock_fallback(vma->vm_mm, FAULT);
 	vma_end_read(vma);
 	return VM_FAULT_RETRY;
 }
@@ -3241,6 +3243,7 @@ vm_fault_t vmf_anon_prepare(struct vm_fault *vmf)
 		return 0;
 	if (vmf->flags & FAULT_FLAG_VMA_LOCK) {
 		if (!mmap_read_trylock(vma->vm_mm)) {
+			count_vma_lock_fallback(vma->vm_mm, ANON);
 			vma_end_read(vma);
 			return VM_FAULT_RETRY;
 		}
@@ -3976,6 +3979,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 				 * migrate_to_ram is not yet ready to operate
 				 * under VMA lock.
 				 */
+				count_vma_lock_fallback(vma->vm_mm, DEVICE);
 				vma_end_read(vma);
 				ret = VM_FAULT_RETRY;
 				goto out;
@@ -5688,8 +5692,40 @@ EXPORT_SYMBOL_GPL(handle_mm_fault);
 #ifdef CONFIG_LOCK_MM_AND_FIND_VMA
 #include <linux/extable.h>
 
+#ifdef CONFIG_PER_VMA_LOCK_STATS
+static inline u64 mmap_lock_wait_start(void)
+{
+	return local_clock();
+}
+
+static void count_mmap_lock_wait(struct mm_struct *mm, u64 start)
+{
+	u64 wait = local_clock() - start;
+	u64 limit = 10 * NSEC_PER_USEC;
+	int i;
+
+	for (i = 0; i < NR_MMAP_LOCK_WAIT_BUCKETS - 1; i++, limit *= 10) {
+		if (wait < limit)
+			break;
+	}
+	atomic_long_inc(&mm->vma_lock_stats.mmap_lock_wait[i]);
+}
+#else
+static inline u64 mmap_lock_wait_start(void)
+{
+	return 0;
+}
+
+static inline void count_mmap_lock_wait(struct mm_struct *mm, u64 start)
+{
+}
+#endif
+
 static inline bool get_mmap_lock_carefully(struct mm_struct *mm, struct pt_regs *regs)
 {
+	u64 start;
+	int ret;
+
 	if (likely(mmap_read_trylock(mm)))
 		return true;
 
@@ -5699,7 +5735,11 @@ static inline bool get_mmap_lock_carefully(struct mm_struct *mm, struct pt_regs
 			return false;
 	}
 
-	return !mmap_read_lock_killable(mm);
+	start = mmap_lock_wait_start();
+	ret = mmap_read_lock_killable(mm);
+	count_mmap_lock_wait(mm, start);
+
+	return !ret;
 }
 
 static inline bool mmap_upgrade_trylock(struct mm_struct *mm)
@@ -5841,7 +5881,7 @@ struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
 	vma_end_read(vma);
 inval:
 	rcu_read_unlock();
-	count_vm_vma_lock_event(VMA_LOCK_ABORT);
+	count_vma_lock_fallback(mm, ABORT);
 	return NULL;
 }
 #endif /* CONFIG_PER_VMA_LOCK */
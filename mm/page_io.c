@@ -205,6 +205,58 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 	return 0;
 }
 
+/*
+ * Batched swap_writepage() for reclaim: the folios zswap accepts are
+ * compressed and inserted together, the others are written to the swap
+ * device. As with swap_writepage(), every folio is unlocked on return,
+ * and @errors[i] holds what swap_writepage() would have returned for
+ * @folios[i].
+ */
+void swap_writepage_batch(struct folio **folios, int *errors, int nr,
+			  struct writeback_control *wbc)
+{
+	struct folio *batch[ZSWAP_STORE_BATCH_MAX];
+	unsigned long stored;
+	int i, nr_batch = 0;
+
+	VM_WARN_ON_ONCE(nr > ZSWAP_STORE_BATCH_MAX);
+
+	for (i = 0; i < nr; i++) {
+		struct folio *folio = folios[i];
+
+		errors[i] = 0;
+		if (folio_free_swap(folio)) {
+			folio_unlock(folio);
+			continue;
+		}
+		/*
+		 * Arch code may have to preserve more data than just the page
+		 * contents, e.g. memory tags.
+		 */
+		errors[i] = arch_prepare_to_swap(folio);
+		if (errors[i]) {
+			folio_mark_dirty(folio);
+			folio_unlock(folio);
+			continue;
+		}
+		batch[nr_batch++] = folio;
+	}
+
+	zswap_store_batch(batch, nr_batch, &stored);
+
+	for (i = 0; i < nr_batch; i++) {
+		struct folio *folio = batch[i];
+
+		if (test_bit(i, &stored)) {
+			folio_start_writeback(folio);
+			folio_unlock(folio);
+			folio_end_writeback(folio);
+		} else {
+			__swap_writepage(&folio->page, wbc);
+		}
+	}
+}
+
 static inline void count_swpout_vm_event(struct folio *folio)
 {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
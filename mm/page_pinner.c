@@ -11,6 +11,7 @@
 #include <linux/stackdepot.h>
 #include <linux/seq_file.h>
 #include <linux/sched/clock.h>
+#include <linux/hash.h>
 
 #include "internal.h"
 
@@ -21,6 +22,8 @@ struct page_pinner {
 	depot_stack_handle_t handle;
 	u64 ts_usec;
 	atomic_t count;
+	/* lite mode: caller of the GUP call that last took a reference */
+	unsigned long pin_ip;
 };
 
 enum pp_state {
@@ -54,7 +57,35 @@ struct page_pinner_buffer {
 /* alloc_contig failed pinner */
 static struct page_pinner_buffer pp_buffer;
 
-static bool page_pinner_enabled;
+/*
+ * Lite mode keeps no per-event records and unwinds no stack on the hot
+ * path. Instead, GUP records its caller in the page_pinner of every page
+ * it returns, and every put of a page that failed migration is accounted
+ * to that pin site in a fixed hash table. Pages referenced other than
+ * through GUP are accounted to the put call site. Only one in
+ * pp_sample_rate puts per site saves a full stack of the put.
+ */
+#define PP_SITE_BITS	10
+#define PP_SITE_PROBES	8
+
+struct pp_site {
+	unsigned long ip;
+	atomic64_t count;
+	atomic64_t total_us;
+	atomic64_t max_us;
+	depot_stack_handle_t handle;
+};
+
+static struct pp_site *pp_sites;
+static atomic_long_t pp_sites_dropped;
+static atomic_long_t pp_lite_failures;
+static unsigned int pp_sample_rate = 64;
+
+/* Number of pages flagged PAGE_EXT_PINNER_MIGRATION_FAILED */
+static atomic_long_t pp_nr_failed;
+
+static bool page_pinner_enabled = IS_ENABLED(CONFIG_PAGE_PINNER_LITE);
+static bool page_pinner_lite = IS_ENABLED(CONFIG_PAGE_PINNER_LITE);
 DEFINE_STATIC_KEY_FALSE(page_pinner_inited);
 EXPORT_SYMBOL_GPL(page_pinner_inited);
 
@@ -65,6 +96,7 @@ static depot_stack_handle_t failure_handle;
 static int __init early_page_pinner_param(char *buf)
 {
 	page_pinner_enabled = true;
+	page_pinner_lite = buf && !strcmp(buf, "lite");
 	return 0;
 }
 early_param("page_pinner", early_page_pinner_param);
@@ -88,6 +120,18 @@ static void init_page_pinner(void)
 	if (!page_pinner_enabled)
 		return;
 
+	if (page_pinner_lite) {
+		pp_sites = kvcalloc(1 << PP_SITE_BITS, sizeof(*pp_sites),
+				    GFP_KERNEL);
+		if (!pp_sites) {
+			pr_info("page_pinner disabled due to failure of site table allocation\n");
+			return;
+		}
+		register_failure_stack();
+		static_branch_enable(&page_pinner_inited);
+		return;
+	}
+
 	pp_buffer.buffer = kvmalloc_array(pp_buf_size, sizeof(*pp_buffer.buffer),
 				GFP_KERNEL);
 	if (!pp_buffer.buffer) {
@@ -127,6 +171,47 @@ static noinline depot_stack_handle_t save_stack(gfp_t flags)
 	return handle;
 }
 
+static struct pp_site *pp_site_get(unsigned long ip)
+{
+	unsigned int mask = (1 << PP_SITE_BITS) - 1;
+	unsigned int idx = hash_long(ip, PP_SITE_BITS);
+	unsigned long cur;
+	int i;
+
+	for (i = 0; i < PP_SITE_PROBES; i++, idx = (idx + 1) & mask) {
+		cur = READ_ONCE(pp_sites[idx].ip);
+		if (!cur)
+			cur = cmpxchg(&pp_sites[idx].ip, 0, ip);
+		if (!cur || cur == ip)
+			return &pp_sites[idx];
+	}
+
+	return NULL;
+}
+
+static void pp_site_account(unsigned long ip, u64 elapsed)
+{
+	struct pp_site *site = pp_site_get(ip);
+	u64 nr;
+	s64 max;
+
+	if (!site) {
+		atomic_long_inc(&pp_sites_dropped);
+		return;
+	}
+
+	/* Unwind the first put and then one in pp_sample_rate puts */
+	nr = atomic64_inc_return(&site->count) - 1;
+	if (!do_div(nr, READ_ONCE(pp_sample_rate)))
+		WRITE_ONCE(site->handle, save_stack(GFP_NOWAIT|__GFP_NOWARN));
+
+	atomic64_add(elapsed, &site->total_us);
+	max = atomic64_read(&site->max_us);
+	while (elapsed > max &&
+	       !atomic64_try_cmpxchg(&site->max_us, &max, elapsed))
+		;
+}
+
 static void capture_page_state(struct page *page,
 			       struct captured_pinner *record)
 {
@@ -157,7 +242,10 @@ void __free_page_pinner(struct page *page, unsigned int order)
 	int i;
 
 	/* free_page could be called before buffer is initialized */
-	if (!pp_buffer.buffer)
+	if (!page_pinner_lite && !pp_buffer.buffer)
+		return;
+
+	if (!atomic_long_read(&pp_nr_failed))
 		return;
 
 	page_ext = page_ext_get(page);
@@ -172,16 +260,21 @@ void __free_page_pinner(struct page *page, unsigned int order)
 
 		page_pinner = get_page_pinner(page_ext);
 
-		record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
-		record.ts_usec = (u64)ktime_to_us(ktime_get_boottime());
-		record.state = PP_FREE;
-		capture_page_state(page, &record);
+		if (!page_pinner_lite) {
+			record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
+			record.ts_usec = (u64)ktime_to_us(ktime_get_boottime());
+			record.state = PP_FREE;
+			capture_page_state(page, &record);
 
-		add_record(&pp_buffer, &record);
+			add_record(&pp_buffer, &record);
+		}
 
 		atomic_set(&page_pinner->count, 0);
 		page_pinner->ts_usec = 0;
-		clear_bit(PAGE_EXT_PINNER_MIGRATION_FAILED, &page_ext->flags);
+		page_pinner->pin_ip = 0;
+		if (test_and_clear_bit(PAGE_EXT_PINNER_MIGRATION_FAILED,
+				       &page_ext->flags))
+			atomic_long_dec(&pp_nr_failed);
 		page_ext = page_ext_next(page_ext);
 	}
 	page_ext_put(page_ext);
@@ -273,7 +366,16 @@ void __page_pinner_failure_detect(struct page *page)
 	page_pinner = get_page_pinner(page_ext);
 	if (!page_pinner->ts_usec)
 		page_pinner->ts_usec = now;
-	set_bit(PAGE_EXT_PINNER_MIGRATION_FAILED, &page_ext->flags);
+	if (!test_and_set_bit(PAGE_EXT_PINNER_MIGRATION_FAILED,
+			      &page_ext->flags))
+		atomic_long_inc(&pp_nr_failed);
+
+	if (page_pinner_lite) {
+		atomic_long_inc(&pp_lite_failures);
+		page_ext_put(page_ext);
+		return;
+	}
+
 	record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
 	record.ts_usec = now;
 	record.state = PP_FAIL_DETECTED;
@@ -294,6 +396,10 @@ void __page_pinner_put_page(struct page *page)
 	if (!static_branch_unlikely(&failure_tracking))
 		return;
 
+	/* Skip the page_ext lookup while no page is flagged */
+	if (!atomic_long_read(&pp_nr_failed))
+		return;
+
 	page_ext = page_ext_get(page);
 	if (unlikely(!page_ext))
 		return;
@@ -304,10 +410,17 @@ void __page_pinner_put_page(struct page *page)
 	}
 
 	page_pinner = get_page_pinner(page_ext);
-	record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
 	now = (u64)ktime_to_us(ktime_get_boottime());
 	ts_usec = page_pinner->ts_usec;
 
+	if (page_pinner_lite) {
+		pp_site_account(READ_ONCE(page_pinner->pin_ip) ?: _RET_IP_,
+				now > ts_usec ? now - ts_usec : 0);
+		page_ext_put(page_ext);
+		return;
+	}
+
+	record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
 	if (now > ts_usec)
 		record.elapsed = now - ts_usec;
 	else
@@ -320,6 +433,27 @@ void __page_pinner_put_page(struct page *page)
 }
 EXPORT_SYMBOL_GPL(__page_pinner_put_page);
 
+/*
+ * Called by the GUP entry points with the pages they returned, so that lite
+ * mode can attribute a later put of a page to the code that pinned it.
+ */
+void __page_pinner_record_pin(struct page **pages, long nr, unsigned long ip)
+{
+	struct page_ext *page_ext;
+	long i;
+
+	if (!page_pinner_lite)
+		return;
+
+	for (i = 0; i < nr; i++) {
+		page_ext = page_ext_get(pages[i]);
+		if (unlikely(!page_ext))
+			continue;
+		WRITE_ONCE(get_page_pinner(page_ext)->pin_ip, ip);
+		page_ext_put(page_ext);
+	}
+}
+
 static ssize_t read_buffer(struct file *file, char __user *buf,
 					size_t count, loff_t *ppos)
 {
@@ -407,6 +541,61 @@ DEFINE_DEBUGFS_ATTRIBUTE(buffer_size_fops,
 			 buffer_size_get,
 			 buffer_size_set, "%llu\n");
 
+static int sites_show(struct seq_file *m, void *v)
+{
+	unsigned long *entries;
+	unsigned int nr_entries;
+	struct pp_site *site;
+	u64 count;
+	int i, j;
+
+	seq_printf(m, "failures %ld dropped %ld\n",
+		   atomic_long_read(&pp_lite_failures),
+		   atomic_long_read(&pp_sites_dropped));
+
+	for (i = 0; i < (1 << PP_SITE_BITS); i++) {
+		site = &pp_sites[i];
+		if (!READ_ONCE(site->ip))
+			continue;
+
+		count = atomic64_read(&site->count);
+		seq_printf(m, "%pS count %llu total_us %lld avg_us %llu max_us %lld\n",
+			   (void *)site->ip, count,
+			   atomic64_read(&site->total_us),
+			   count ? div64_u64(atomic64_read(&site->total_us), count) : 0,
+			   atomic64_read(&site->max_us));
+
+		if (!READ_ONCE(site->handle))
+			continue;
+
+		nr_entries = stack_depot_fetch(READ_ONCE(site->handle), &entries);
+		for (j = 0; j < nr_entries; j++)
+			seq_printf(m, " %pS\n", (void *)entries[j]);
+		seq_putc(m, '\n');
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sites);
+
+static int sample_rate_set(void *data, u64 val)
+{
+	if (!val || val > UINT_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(pp_sample_rate, val);
+	return 0;
+}
+
+static int sample_rate_get(void *data, u64 *val)
+{
+	*val = pp_sample_rate;
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(sample_rate_fops,
+			 sample_rate_get,
+			 sample_rate_set, "%llu\n");
+
 static int __init page_pinner_init(void)
 {
 	struct dentry *pp_debugfs_root;
@@ -414,18 +603,29 @@ static int __init page_pinner_init(void)
 	if (!static_branch_unlikely(&page_pinner_inited))
 		return 0;
 
-	pr_info("page_pinner enabled\n");
+	pr_info("page_pinner enabled%s\n", page_pinner_lite ? " (lite)" : "");
 
 	pp_debugfs_root = debugfs_create_dir("page_pinner", NULL);
 
-	debugfs_create_file("buffer", 0444,
-			    pp_debugfs_root, NULL,
-			    &proc_buffer_operations);
-
 	debugfs_create_file("failure_tracking", 0644,
 			    pp_debugfs_root, NULL,
 			    &failure_tracking_fops);
 
+	if (page_pinner_lite) {
+		debugfs_create_file("sites", 0444,
+				    pp_debugfs_root, NULL,
+				    &sites_fops);
+
+		debugfs_create_file("sample_rate", 0644,
+				    pp_debugfs_root, NULL,
+				    &sample_rate_fops);
+		return 0;
+	}
+
+	debugfs_create_file("buffer", 0444,
+			    pp_debugfs_root, NULL,
+			    &proc_buffer_operations);
+
 	debugfs_create_file("buffer_size", 0644,
 			    pp_debugfs_root, NULL,
 			    &buffer_size_fops);
@@ -17,6 +17,7 @@
 #include <linux/kobject.h>
 #include <linux/kstrtox.h>
 #include <linux/sched/task_stack.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/sysfs.h>
@@ -154,6 +155,76 @@ static __always_inline bool str_has_suffix(const char *str, const char *suffix)
 	return !strncmp(str + str_len - suffix_len, suffix, suffix_len);
 }
 
+/*
+ * Inodes of the dynamic linker(s) already identified by linker_ctx().
+ *
+ * There are only a handful of linker binaries on a device, but the
+ * linker madvises the padding of every library it loads, so resolving
+ * the path of the caller's VMA each time shows up in app cold start.
+ *
+ * Entries identify an inode by super block, inode number and generation
+ * rather than by pointer, so no reference is held on the inode or its
+ * mount. Once the cache is full, the oldest entry is replaced.
+ */
+#define LINKER_INODE_CACHE_SIZE	4
+
+struct linker_inode {
+	struct super_block *sb;
+	unsigned long ino;
+	u32 generation;
+};
+
+static struct linker_inode linker_inodes[LINKER_INODE_CACHE_SIZE];
+static unsigned int linker_inodes_next;
+static DEFINE_SEQLOCK(linker_inodes_lock);
+
+static bool linker_inode_match(const struct linker_inode *li,
+			       const struct inode *inode)
+{
+	return li->sb == inode->i_sb && li->ino == inode->i_ino &&
+	       li->generation == inode->i_generation;
+}
+
+static bool linker_inode_cached(struct inode *inode)
+{
+	unsigned int seq;
+	bool found;
+	int i;
+
+	do {
+		seq = read_seqbegin(&linker_inodes_lock);
+		found = false;
+		for (i = 0; i < LINKER_INODE_CACHE_SIZE; i++) {
+			if (linker_inode_match(&linker_inodes[i], inode)) {
+				found = true;
+				break;
+			}
+		}
+	} while (read_seqretry(&linker_inodes_lock, seq));
+
+	return found;
+}
+
+static void linker_inode_cache_add(struct inode *inode)
+{
+	struct linker_inode *li;
+	int i;
+
+	write_seqlock(&linker_inodes_lock);
+	for (i = 0; i < LINKER_INODE_CACHE_SIZE; i++) {
+		if (linker_inode_match(&linker_inodes[i], inode))
+			goto out;
+	}
+
+	li = &linker_inodes[linker_inodes_next];
+	li->sb = inode->i_sb;
+	li->ino = inode->i_ino;
+	li->generation = inode->i_generation;
+	linker_inodes_next = (linker_inodes_next + 1) % LINKER_INODE_CACHE_SIZE;
+out:
+	write_sequnlock(&linker_inodes_lock);
+}
+
 /*
  * The dynamic linker, or interpreter, operates within the process context
  * of the binary that necessitated dynamic linking.
@@ -190,10 +261,14 @@ static inline bool linker_ctx(void)
 		return false;
 
 	if ((vma->vm_flags & VM_EXEC)) {
+		struct inode *inode = file_inode(file);
 		char buf[64];
 		const int bufsize = sizeof(buf);
 		char *path;
 
+		if (linker_inode_cached(inode))
+			return true;
+
 		memset(buf, 0, bufsize);
 		path = d_path(&file->f_path, buf, bufsize);
 
@@ -205,8 +280,10 @@ static inline bool linker_ctx(void)
 		 *
 		 * Check the base name (linker64).
 		 */
-		if (!strcmp(kbasename(path), "linker64"))
+		if (!IS_ERR(path) && !strcmp(kbasename(path), "linker64")) {
+			linker_inode_cache_add(inode);
 			return true;
+		}
 	}
 
 	return false;
@@ -128,6 +128,10 @@
 #include <linux/blk-cgroup.h>
 #include <linux/fadvise.h>
 #include <linux/sched/mm.h>
+#include <linux/hashtable.h>
+#include <linux/moduleparam.h>
+#include <linux/rculist.h>
+#include <linux/sizes.h>
 #include <trace/hooks/mm.h>
 
 #include "internal.h"
@@ -852,3 +856,247 @@ void readahead_expand(struct readahead_control *ractl,
 	}
 }
 EXPORT_SYMBOL(readahead_expand);
+
+/*
+ * Readahead replay
+ *
+ * App launches fault in the same scattered parts of their APK, dex and
+ * odex mappings every time. The mmap read-around handles those one small
+ * window at a time, with a synchronous read for each. To speed this up,
+ * remember which chunks of a file were faulted during the first
+ * ra_replay_window_ms after it took a major fault. When the file takes a
+ * major fault again after it lost most of its page cache, read all of
+ * those chunks at once with large folios and record the new launch.
+ *
+ * A chunk matches the default fault-around window, so that the first
+ * access to a chunk reaches either filemap_fault() or filemap_map_pages()
+ * and is recorded even when its pages were already read by a replay.
+ */
+#define RA_HISTORY_CHUNK_PAGES	16
+#define RA_HISTORY_MAX_CHUNKS	(SZ_1G / (RA_HISTORY_CHUNK_PAGES * PAGE_SIZE))
+#define RA_HISTORY_HASH_BITS	8
+
+static bool ra_replay __read_mostly;
+module_param(ra_replay, bool, 0644);
+
+static unsigned int ra_replay_window_ms __read_mostly = 5000;
+module_param(ra_replay_window_ms, uint, 0644);
+
+static unsigned int ra_replay_max_files __read_mostly = 256;
+module_param(ra_replay_max_files, uint, 0644);
+
+struct ra_history {
+	struct hlist_node node;
+	struct list_head list;
+	struct rcu_head rcu;
+	/*
+	 * Keyed on the device rather than the super_block, whose address
+	 * can be reused by another mount once it is freed.
+	 */
+	dev_t dev;
+	unsigned long ino;
+	u32 generation;
+	loff_t size;
+	/* jiffies when the current recording window closes */
+	unsigned long window_end;
+	unsigned int nr_chunks;
+	unsigned long bitmap[];
+};
+
+static DEFINE_HASHTABLE(ra_history_hash, RA_HISTORY_HASH_BITS);
+static LIST_HEAD(ra_history_list);
+static DEFINE_SPINLOCK(ra_history_lock);
+static unsigned int ra_history_count;
+
+static struct ra_history *ra_history_lookup(struct inode *inode)
+{
+	struct ra_history *h;
+
+	hash_for_each_possible_rcu(ra_history_hash, h, node, inode->i_ino) {
+		if (h->ino == inode->i_ino && h->dev == inode->i_sb->s_dev &&
+		    h->generation == inode->i_generation)
+			return h;
+	}
+
+	return NULL;
+}
+
+static void ra_history_add(struct inode *inode, pgoff_t index)
+{
+	loff_t size = i_size_read(inode);
+	unsigned int nr_chunks;
+	struct ra_history *h, *old = NULL;
+
+	nr_chunks = min_t(loff_t, DIV_ROUND_UP(size,
+			  RA_HISTORY_CHUNK_PAGES * PAGE_SIZE), RA_HISTORY_MAX_CHUNKS);
+	if (!nr_chunks)
+		return;
+
+	h = kzalloc(struct_size(h, bitmap, BITS_TO_LONGS(nr_chunks)),
+		    GFP_NOWAIT | __GFP_NOWARN);
+	if (!h)
+		return;
+
+	h->dev = inode->i_sb->s_dev;
+	h->ino = inode->i_ino;
+	h->generation = inode->i_generation;
+	h->size = size;
+	h->nr_chunks = nr_chunks;
+	h->window_end = jiffies + msecs_to_jiffies(READ_ONCE(ra_replay_window_ms));
+	if (index / RA_HISTORY_CHUNK_PAGES < nr_chunks)
+		__set_bit(index / RA_HISTORY_CHUNK_PAGES, h->bitmap);
+
+	spin_lock(&ra_history_lock);
+	if (ra_history_lookup(inode)) {
+		spin_unlock(&ra_history_lock);
+		kfree(h);
+		return;
+	}
+
+	/* Drop the oldest file when full */
+	if (ra_history_count >= READ_ONCE(ra_replay_max_files) &&
+	    !list_empty(&ra_history_list)) {
+		old = list_last_entry(&ra_history_list, struct ra_history, list);
+		list_del(&old->list);
+		hash_del_rcu(&old->node);
+		ra_history_count--;
+	}
+
+	hash_add_rcu(ra_history_hash, &h->node, h->ino);
+	list_add(&h->list, &ra_history_list);
+	ra_history_count++;
+	spin_unlock(&ra_history_lock);
+
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+static void ra_history_del(struct ra_history *h)
+{
+	spin_lock(&ra_history_lock);
+	if (hash_hashed(&h->node)) {
+		list_del(&h->list);
+		hash_del_rcu(&h->node);
+		ra_history_count--;
+		kfree_rcu(h, rcu);
+	}
+	spin_unlock(&ra_history_lock);
+}
+
+/*
+ * Record an access to @index of @file if its recording window is open.
+ * Called for every file fault, so it must stay cheap.
+ */
+void page_cache_ra_record(struct file *file, pgoff_t index)
+{
+	struct ra_history *h;
+	unsigned long chunk = index / RA_HISTORY_CHUNK_PAGES;
+
+	if (!READ_ONCE(ra_replay) || !READ_ONCE(ra_history_count))
+		return;
+
+	rcu_read_lock();
+	h = ra_history_lookup(file_inode(file));
+	if (h && chunk < h->nr_chunks &&
+	    time_before(jiffies, READ_ONCE(h->window_end)) &&
+	    !test_bit(chunk, h->bitmap))
+		set_bit(chunk, h->bitmap);
+	rcu_read_unlock();
+}
+
+static void ra_replay_range(struct file *file, pgoff_t index, unsigned long nr)
+{
+	struct file_ra_state ra = {
+		.start = index,
+		.size = nr,
+	};
+	DEFINE_READAHEAD(ractl, file, &ra, file->f_mapping, index);
+
+	page_cache_ra_order(&ractl, &ra, ilog2(RA_HISTORY_CHUNK_PAGES));
+}
+
+/*
+ * Called on a major fault at @vmf->pgoff. Records it, and if the file went
+ * cold since the last recorded launch, reads everything that launch
+ * faulted in. Returns the file pinned if the mmap_lock had to be dropped.
+ */
+struct file *page_cache_ra_replay(struct vm_fault *vmf, struct file *fpin)
+{
+	struct file *file = vmf->vma->vm_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = file_inode(file);
+	unsigned long chunk = vmf->pgoff / RA_HISTORY_CHUNK_PAGES;
+	unsigned long window_end, start, end, *bitmap;
+	unsigned int nr_chunks, nr_set;
+	struct ra_history *h;
+
+	if (!READ_ONCE(ra_replay))
+		return fpin;
+
+	if (unlikely(!mapping->a_ops->read_folio && !mapping->a_ops->readahead))
+		return fpin;
+
+	rcu_read_lock();
+	h = ra_history_lookup(inode);
+	if (!h) {
+		rcu_read_unlock();
+		ra_history_add(inode, vmf->pgoff);
+		return fpin;
+	}
+
+	window_end = READ_ONCE(h->window_end);
+	if (time_before(jiffies, window_end)) {
+		if (chunk < h->nr_chunks)
+			set_bit(chunk, h->bitmap);
+		rcu_read_unlock();
+		return fpin;
+	}
+
+	/* The file changed, start over */
+	if (h->size != i_size_read(inode)) {
+		ra_history_del(h);
+		rcu_read_unlock();
+		ra_history_add(inode, vmf->pgoff);
+		return fpin;
+	}
+
+	/* Only replay if most of the last launch is gone from the cache */
+	nr_set = bitmap_weight(h->bitmap, h->nr_chunks);
+	if (!nr_set || mapping->nrpages * 2 >= nr_set * RA_HISTORY_CHUNK_PAGES) {
+		rcu_read_unlock();
+		return fpin;
+	}
+
+	/* Only one fault gets to replay and open the new window */
+	if (cmpxchg(&h->window_end, window_end, jiffies +
+		    msecs_to_jiffies(READ_ONCE(ra_replay_window_ms))) != window_end) {
+		rcu_read_unlock();
+		return fpin;
+	}
+
+	nr_chunks = h->nr_chunks;
+	bitmap = bitmap_alloc(nr_chunks, GFP_NOWAIT | __GFP_NOWARN);
+	if (bitmap) {
+		bitmap_copy(bitmap, h->bitmap, nr_chunks);
+		bitmap_zero(h->bitmap, nr_chunks);
+	}
+	if (chunk < nr_chunks)
+		set_bit(chunk, h->bitmap);
+	rcu_read_unlock();
+
+	if (!bitmap)
+		return fpin;
+
+	fpin = maybe_unlock_mmap_for_io(vmf, fpin);
+	count_vm_event(RA_REPLAY);
+
+	for_each_set_bitrange(start, end, bitmap, nr_chunks) {
+		ra_replay_range(file, start * RA_HISTORY_CHUNK_PAGES,
+				(end - start) * RA_HISTORY_CHUNK_PAGES);
+		count_vm_events(RA_REPLAY_PAGES,
+				(end - start) * RA_HISTORY_CHUNK_PAGES);
+	}
+	bitmap_free(bitmap);
+
+	return fpin;
+}
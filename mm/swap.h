@@ -18,6 +18,8 @@ static inline void swap_read_unplug(struct swap_iocb *plug)
 void swap_write_unplug(struct swap_iocb *sio);
 int swap_writepage(struct page *page, struct writeback_control *wbc);
 void __swap_writepage(struct page *page, struct writeback_control *wbc);
+void swap_writepage_batch(struct folio **folios, int *errors, int nr,
+			  struct writeback_control *wbc);
 
 /* linux/mm/swap_state.c */
 /* One swap address space for each 64M swap space */
@@ -97,6 +99,11 @@ static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 	return 0;
 }
 
+static inline void swap_writepage_batch(struct folio **folios, int *errors,
+					int nr, struct writeback_control *wbc)
+{
+}
+
 static inline void swapcache_clear(struct swap_info_struct *si, swp_entry_t entry)
 {
 }
@@ -21,6 +21,7 @@
 #include <linux/swap_slots.h>
 #include <linux/huge_mm.h>
 #include <linux/shmem_fs.h>
+#include <linux/zswap.h>
 #include "internal.h"
 #include "swap.h"
 
@@ -39,6 +40,11 @@ static const struct address_space_operations swap_aops = {
 struct address_space *swapper_spaces[MAX_SWAPFILES] __read_mostly;
 static unsigned int nr_swapper_spaces[MAX_SWAPFILES] __read_mostly;
 static bool enable_vma_readahead __read_mostly = true;
+/*
+ * Minimum percentage of the previous readahead window that must have been
+ * used to keep reading ahead from in-memory swap. 0 disables the check.
+ */
+static unsigned int inmem_ra_hit_ratio __read_mostly = 50;
 
 #define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
 #define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
@@ -589,10 +595,46 @@ static unsigned int __swapin_nr_pages(unsigned long prev_offset,
 	return pages;
 }
 
-static unsigned long swapin_nr_pages(unsigned long offset)
+/*
+ * Swap held in memory, by a SWP_SYNCHRONOUS_IO device such as zram or by
+ * zswap, has no seek cost to amortize: every page read ahead costs a
+ * decompression and a page allocation, which are wasted if the page is not
+ * used. Keep reading ahead only while enough of the previous window was
+ * used. Pages that zswap wrote back live on the device and are not affected.
+ * zram pages written back to its backing device are still treated as in
+ * memory, as zram does not tell which slots it wrote back.
+ */
+static unsigned int swapin_nr_pages_inmem(swp_entry_t entry,
+					  unsigned int pages,
+					  unsigned int hits,
+					  unsigned int prev_win)
+{
+	unsigned int ratio = READ_ONCE(inmem_ra_hit_ratio);
+	struct swap_info_struct *si = swp_swap_info(entry);
+
+	if (pages <= 1 || !ratio)
+		return pages;
+
+	if (!data_race(si->flags & SWP_SYNCHRONOUS_IO) && !zswap_stored(entry))
+		return pages;
+
+	/* No readahead to judge by: allow a small probe */
+	if (prev_win <= 1)
+		return min(pages, 2U);
+
+	if (hits * 100 < (prev_win - 1) * ratio) {
+		count_vm_event(SWAP_RA_INMEM_SKIP);
+		return 1;
+	}
+
+	return pages;
+}
+
+static unsigned long swapin_nr_pages(swp_entry_t entry)
 {
 	static unsigned long prev_offset;
-	unsigned int hits, pages, max_pages;
+	unsigned long offset = swp_offset(entry);
+	unsigned int hits, pages, max_pages, prev_win;
 	static atomic_t last_readahead_pages;
 
 	max_pages = 1 << READ_ONCE(page_cluster);
@@ -600,9 +642,10 @@ static unsigned long swapin_nr_pages(unsigned long offset)
 		return 1;
 
 	hits = atomic_xchg(&swapin_readahead_hits, 0);
+	prev_win = atomic_read(&last_readahead_pages);
 	pages = __swapin_nr_pages(READ_ONCE(prev_offset), offset, hits,
-				  max_pages,
-				  atomic_read(&last_readahead_pages));
+				  max_pages, prev_win);
+	pages = swapin_nr_pages_inmem(entry, pages, hits, prev_win);
 	if (!hits)
 		WRITE_ONCE(prev_offset, offset);
 	atomic_set(&last_readahead_pages, pages);
@@ -643,7 +686,7 @@ struct page *swap_cluster_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	struct vm_area_struct *vma = vmf->vma;
 	unsigned long addr = vmf->address;
 
-	mask = swapin_nr_pages(offset) - 1;
+	mask = swapin_nr_pages(entry) - 1;
 	if (!mask)
 		goto skip;
 
@@ -724,7 +767,7 @@ struct vma_swap_readahead {
 	unsigned short nr_pte;
 };
 
-static void swap_ra_info(struct vm_fault *vmf,
+static void swap_ra_info(struct vm_fault *vmf, swp_entry_t entry,
 			 struct vma_swap_readahead *ra_info)
 {
 	struct vm_area_struct *vma = vmf->vma;
@@ -746,8 +789,8 @@ static void swap_ra_info(struct vm_fault *vmf,
 	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
 	prev_win = SWAP_RA_WIN(ra_val);
 	hits = SWAP_RA_HITS(ra_val);
-	ra_info->win = win = __swapin_nr_pages(pfn, fpfn, hits,
-					       max_win, prev_win);
+	win = __swapin_nr_pages(pfn, fpfn, hits, max_win, prev_win);
+	ra_info->win = win = swapin_nr_pages_inmem(entry, win, hits, prev_win);
 	atomic_long_set(&vma->swap_readahead_info,
 			SWAP_RA_VAL(faddr, win, 0));
 	if (win == 1)
@@ -804,7 +847,7 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 		.win = 1,
 	};
 
-	swap_ra_info(vmf, &ra_info);
+	swap_ra_info(vmf, fentry, &ra_info);
 	if (ra_info.win == 1)
 		goto skip;
 
@@ -890,8 +933,34 @@ static ssize_t vma_ra_enabled_store(struct kobject *kobj,
 }
 static struct kobj_attribute vma_ra_enabled_attr = __ATTR_RW(vma_ra_enabled);
 
+static ssize_t inmem_ra_hit_ratio_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(inmem_ra_hit_ratio));
+}
+static ssize_t inmem_ra_hit_ratio_store(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int ratio;
+	ssize_t ret;
+
+	ret = kstrtouint(buf, 10, &ratio);
+	if (ret)
+		return ret;
+	if (ratio > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(inmem_ra_hit_ratio, ratio);
+
+	return count;
+}
+static struct kobj_attribute inmem_ra_hit_ratio_attr =
+	__ATTR_RW(inmem_ra_hit_ratio);
+
 static struct attribute *swap_attrs[] = {
 	&vma_ra_enabled_attr.attr,
+	&inmem_ra_hit_ratio_attr.attr,
 	NULL,
 };
 
@@ -63,7 +63,9 @@
 
 #include <linux/swapops.h>
 #include <linux/balloon_compaction.h>
+#include <linux/zswap.h>
 #include <linux/sched/sysctl.h>
+#include <linux/sched/cputime.h>
 
 #include "internal.h"
 #include "swap.h"
@@ -1724,6 +1726,107 @@ static bool may_enter_fs(struct folio *folio, gfp_t gfp_mask)
 	return !data_race(folio_swap_flags(folio) & SWP_FS_OPS);
 }
 
+/*
+ * Swap cache folios that zswap may take are not written one at a time by
+ * pageout() but collected by shrink_folio_list() and handed to
+ * pageout_batch(), so that zswap can compress them back-to-back.
+ * Clears the dirty bit like pageout() when the folio gets batched.
+ */
+static bool pageout_batchable(struct folio *folio,
+			      struct address_space *mapping)
+{
+	if (!folio_test_anon(folio) || !folio_test_swapcache(folio) ||
+	    folio_test_large(folio))
+		return false;
+	if (!zswap_store_batch_enabled())
+		return false;
+	if (!mapping || !is_page_cache_freeable(folio))
+		return false;
+	/* Let pageout() report it as PAGE_CLEAN */
+	if (!folio_clear_dirty_for_io(folio))
+		return false;
+
+	folio_set_reclaim(folio);
+	return true;
+}
+
+/*
+ * Write out the locked folios collected by pageout_batchable() and try to
+ * free those that were stored synchronously, the same way shrink_folio_list()
+ * handles PAGE_SUCCESS. Folios that could not be freed go to @ret_folios.
+ */
+static unsigned int pageout_batch(struct list_head *batch,
+		struct list_head *ret_folios, struct list_head *free_folios,
+		struct scan_control *sc, struct reclaim_stat *stat,
+		struct swap_iocb **plug)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = SWAP_CLUSTER_MAX,
+		.range_start = 0,
+		.range_end = LLONG_MAX,
+		.for_reclaim = 1,
+		.swap_plug = plug,
+	};
+	struct address_space *mappings[ZSWAP_STORE_BATCH_MAX];
+	struct folio *folios[ZSWAP_STORE_BATCH_MAX];
+	int errors[ZSWAP_STORE_BATCH_MAX];
+	struct folio *folio, *next;
+	unsigned int nr_reclaimed = 0;
+	int nr = 0, i = 0;
+
+	list_for_each_entry(folio, batch, lru) {
+		mappings[nr] = folio_mapping(folio);
+		folios[nr++] = folio;
+	}
+
+	swap_writepage_batch(folios, errors, nr, &wbc);
+
+	list_for_each_entry_safe(folio, next, batch, lru) {
+		struct address_space *mapping;
+		unsigned int nr_pages = folio_nr_pages(folio);
+
+		list_del(&folio->lru);
+
+		if (errors[i] < 0)
+			handle_write_error(mappings[i], folio, errors[i]);
+		i++;
+
+		if (!folio_test_writeback(folio)) {
+			/* synchronous write, e.g. stored in zswap */
+			folio_clear_reclaim(folio);
+		}
+		trace_mm_vmscan_write_folio(folio);
+		node_stat_add_folio(folio, NR_VMSCAN_WRITE);
+		stat->nr_pageout += nr_pages;
+
+		if (folio_test_writeback(folio) || folio_test_dirty(folio))
+			goto keep;
+		if (!folio_trylock(folio))
+			goto keep;
+		if (folio_test_dirty(folio) || folio_test_writeback(folio))
+			goto keep_locked;
+
+		/* Swap cache folios never need filemap_release_folio() */
+		mapping = folio_mapping(folio);
+		if (!mapping || !__remove_mapping(mapping, folio, true,
+						  sc->target_mem_cgroup))
+			goto keep_locked;
+
+		folio_unlock(folio);
+		nr_reclaimed += nr_pages;
+		list_add(&folio->lru, free_folios);
+		continue;
+
+keep_locked:
+		folio_unlock(folio);
+keep:
+		list_add(&folio->lru, ret_folios);
+	}
+
+	return nr_reclaimed;
+}
+
 /*
  * shrink_folio_list() returns the number of reclaimed pages
  */
@@ -1734,8 +1837,10 @@ static unsigned int shrink_folio_list(struct list_head *folio_list,
 	LIST_HEAD(ret_folios);
 	LIST_HEAD(free_folios);
 	LIST_HEAD(demote_folios);
+	LIST_HEAD(pageout_folios);
 	unsigned int nr_reclaimed = 0;
 	unsigned int pgactivate = 0;
+	unsigned int nr_pageout_batch = 0;
 	bool do_demote_pass;
 	struct swap_iocb *plug = NULL;
 
@@ -2068,6 +2173,16 @@ static unsigned int shrink_folio_list(struct list_head *folio_list,
 			 * starts and then write it out here.
 			 */
 			try_to_unmap_flush_dirty();
+			if (pageout_batchable(folio, mapping)) {
+				list_add_tail(&folio->lru, &pageout_folios);
+				if (++nr_pageout_batch == ZSWAP_STORE_BATCH_MAX) {
+					nr_reclaimed += pageout_batch(&pageout_folios,
+							&ret_folios, &free_folios,
+							sc, stat, &plug);
+					nr_pageout_batch = 0;
+				}
+				continue;
+			}
 			switch (pageout(folio, mapping, &plug)) {
 			case PAGE_KEEP:
 				goto keep_locked;
@@ -2205,6 +2320,12 @@ static unsigned int shrink_folio_list(struct list_head *folio_list,
 		VM_BUG_ON_FOLIO(folio_test_lru(folio) ||
 				folio_test_unevictable(folio), folio);
 	}
+
+	if (nr_pageout_batch) {
+		nr_reclaimed += pageout_batch(&pageout_folios, &ret_folios,
+					      &free_folios, sc, stat, &plug);
+		nr_pageout_batch = 0;
+	}
 	/* 'folio_list' is always empty here */
 
 	/* Migrate folios selected for demotion */
@@ -5861,6 +5982,263 @@ static void lru_gen_change_state(bool enabled)
 	cgroup_unlock();
 }
 
+/******************************************************************************
+ *                          proactive reclaim
+ ******************************************************************************/
+
+/*
+ * The proactive reclaim engine periodically evicts the generations of each
+ * memcg older than lru_gen_proactive_age, i.e., memory the aging has not
+ * found accessed for that long. Each lruvec throttles itself using the
+ * workingset refaults it saw since the previous pass: if it refaulted more
+ * than lru_gen_proactive_refault percent of what that pass reclaimed, only
+ * half as much of its cold memory is evicted next time, and so on.
+ */
+static unsigned long lru_gen_proactive_age __read_mostly;
+static unsigned int lru_gen_proactive_interval __read_mostly = 10000;
+static unsigned int lru_gen_proactive_cpu __read_mostly = 5;
+static unsigned int lru_gen_proactive_refault __read_mostly = 20;
+/* the memcg to resume from when the previous pass ran out of CPU budget */
+static unsigned short lru_gen_proactive_next_id;
+
+#define MAX_PROACTIVE_BACKOFF	6
+
+struct lru_gen_proactive {
+	/* the memcg this state belongs to, as memcg ids can be reused */
+	struct mem_cgroup *memcg;
+	/* the refault counter at the last pass */
+	unsigned long refaults;
+	/* the pages reclaimed by the last pass */
+	unsigned long reclaimed;
+	/* log2 of the cold memory left alone */
+	unsigned int backoff;
+};
+
+/*
+ * The per-lruvec state, indexed by lru_gen_proactive_key(). Entries are only
+ * added by lru_gen_proactive_fn() and removed by lru_gen_exit_memcg() or when
+ * lru_gen_proactive_fn() finds an entry left by a memcg with the same id.
+ */
+static DEFINE_XARRAY(lru_gen_proactive_xa);
+
+static int run_aging(struct lruvec *lruvec, unsigned long seq, struct scan_control *sc,
+		     bool can_swap, bool force_scan);
+static int run_eviction(struct lruvec *lruvec, unsigned long seq, struct scan_control *sc,
+			int swappiness, unsigned long nr_to_reclaim);
+
+static void lru_gen_proactive_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lru_gen_proactive_work, lru_gen_proactive_fn);
+
+static unsigned long lru_gen_proactive_key(struct mem_cgroup *memcg, int nid)
+{
+	return (unsigned long)mem_cgroup_id(memcg) * nr_node_ids + nid;
+}
+
+static struct lru_gen_proactive *lru_gen_proactive_get(struct lruvec *lruvec)
+{
+	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
+	unsigned long key = lru_gen_proactive_key(memcg, lruvec_pgdat(lruvec)->node_id);
+	struct lru_gen_proactive *state, *stale;
+
+	xa_lock(&lru_gen_proactive_xa);
+	state = xa_load(&lru_gen_proactive_xa, key);
+	if (state && state->memcg == memcg) {
+		xa_unlock(&lru_gen_proactive_xa);
+		return state;
+	}
+	xa_unlock(&lru_gen_proactive_xa);
+
+	state = kzalloc(sizeof(*state), GFP_NOWAIT | __GFP_NOWARN);
+	if (!state)
+		return NULL;
+
+	state->memcg = memcg;
+
+	xa_lock(&lru_gen_proactive_xa);
+	stale = __xa_store(&lru_gen_proactive_xa, key, state, GFP_NOWAIT | __GFP_NOWARN);
+	xa_unlock(&lru_gen_proactive_xa);
+
+	if (xa_is_err(stale)) {
+		kfree(state);
+		return NULL;
+	}
+
+	kfree(stale);
+
+	return state;
+}
+
+static unsigned long lruvec_refaults(struct lruvec *lruvec)
+{
+	return lruvec_page_state_local(lruvec, WORKINGSET_REFAULT_ANON) +
+	       lruvec_page_state_local(lruvec, WORKINGSET_REFAULT_FILE);
+}
+
+/* find the youngest generation older than age and count the pages up to it */
+static bool get_cold_seq(struct lruvec *lruvec, int swappiness, unsigned long age,
+			 unsigned long *cold_seq, unsigned long *nr_cold)
+{
+	int gen, type, zone;
+	unsigned long seq;
+	bool found = false;
+	struct lru_gen_folio *lrugen = &lruvec->lrugen;
+	DEFINE_MAX_SEQ(lruvec);
+	DEFINE_MIN_SEQ(lruvec);
+
+	*nr_cold = 0;
+
+	for (seq = min_seq[!swappiness]; seq + MIN_NR_GENS <= max_seq; seq++) {
+		gen = lru_gen_from_seq(seq);
+
+		if (time_is_after_jiffies(READ_ONCE(lrugen->timestamps[gen]) + age))
+			break;
+
+		for (type = !swappiness; type < ANON_AND_FILE; type++) {
+			if (seq < min_seq[type])
+				continue;
+
+			for (zone = 0; zone < MAX_NR_ZONES; zone++)
+				*nr_cold += max(READ_ONCE(lrugen->nr_pages[gen][type][zone]), 0L);
+		}
+
+		*cold_seq = seq;
+		found = true;
+	}
+
+	return found;
+}
+
+static void lru_gen_proactive_lruvec(struct lruvec *lruvec, struct scan_control *sc,
+				     unsigned long age)
+{
+	unsigned long refaults, refaulted, seq, nr_cold, nr_to_reclaim;
+	struct lru_gen_folio *lrugen = &lruvec->lrugen;
+	struct lru_gen_proactive *state;
+	int swappiness = get_swappiness(lruvec, sc);
+	DEFINE_MAX_SEQ(lruvec);
+
+	state = lru_gen_proactive_get(lruvec);
+	if (!state)
+		return;
+
+	/*
+	 * The refaults also include folios evicted by regular reclaim, which
+	 * only makes the backoff more conservative under memory pressure.
+	 */
+	refaults = lruvec_refaults(lruvec);
+	if (state->reclaimed) {
+		refaulted = min(refaults - state->refaults, state->reclaimed);
+		count_vm_events(LRU_GEN_PROACTIVE_REFAULT, refaulted);
+
+		if (refaulted * 100 > state->reclaimed * READ_ONCE(lru_gen_proactive_refault)) {
+			if (state->backoff < MAX_PROACTIVE_BACKOFF)
+				state->backoff++;
+			count_vm_event(LRU_GEN_PROACTIVE_BACKOFF);
+		} else if (state->backoff) {
+			state->backoff--;
+		}
+	}
+	state->refaults = refaults;
+	state->reclaimed = 0;
+
+	/* the accessed bits haven't been harvested for too long */
+	if (time_is_before_jiffies(READ_ONCE(lrugen->timestamps[lru_gen_from_seq(max_seq)]) + age))
+		run_aging(lruvec, max_seq, sc, swappiness, false);
+
+	if (!get_cold_seq(lruvec, swappiness, age, &seq, &nr_cold))
+		return;
+
+	nr_to_reclaim = nr_cold >> state->backoff;
+	if (!nr_to_reclaim)
+		return;
+
+	run_eviction(lruvec, seq, sc, swappiness, nr_to_reclaim);
+
+	state->reclaimed = sc->nr_reclaimed;
+	count_vm_events(LRU_GEN_PROACTIVE_RECLAIM, sc->nr_reclaimed);
+}
+
+static struct mem_cgroup *lru_gen_proactive_first(void)
+{
+	struct mem_cgroup *memcg = NULL;
+	unsigned short id = lru_gen_proactive_next_id;
+
+	lru_gen_proactive_next_id = 0;
+	if (!id)
+		return mem_cgroup_iter(NULL, NULL, NULL);
+
+	rcu_read_lock();
+	memcg = mem_cgroup_from_id(id);
+	if (memcg && !mem_cgroup_tryget(memcg))
+		memcg = NULL;
+	rcu_read_unlock();
+
+	return memcg ? : mem_cgroup_iter(NULL, NULL, NULL);
+}
+
+static void lru_gen_proactive_fn(struct work_struct *work)
+{
+	int nid;
+	u64 start, budget;
+	unsigned int flags;
+	struct blk_plug plug;
+	struct mem_cgroup *memcg;
+	unsigned long age = READ_ONCE(lru_gen_proactive_age);
+	unsigned int interval = READ_ONCE(lru_gen_proactive_interval);
+	struct scan_control sc = {
+		.may_writepage = true,
+		.may_unmap = true,
+		.may_swap = true,
+		.reclaim_idx = MAX_NR_ZONES - 1,
+		.gfp_mask = GFP_KERNEL,
+		.proactive = 1,
+	};
+
+	if (!age || !lru_gen_enabled())
+		return;
+
+	budget = div_u64((u64)interval * NSEC_PER_MSEC * READ_ONCE(lru_gen_proactive_cpu), 100);
+	start = task_sched_runtime(current);
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+	flags = memalloc_noreclaim_save();
+	blk_start_plug(&plug);
+	if (!set_mm_walk(NULL, true))
+		goto done;
+
+	mem_cgroup_flush_stats(NULL);
+
+	memcg = lru_gen_proactive_first();
+	do {
+		mem_cgroup_calculate_protection(NULL, memcg);
+
+		if (!mem_cgroup_below_min(NULL, memcg) &&
+		    !mem_cgroup_below_low(NULL, memcg)) {
+			for_each_node_state(nid, N_MEMORY) {
+				lru_gen_proactive_lruvec(get_lruvec(memcg, nid), &sc, age);
+				cond_resched();
+			}
+		}
+
+		if (task_sched_runtime(current) - start > budget) {
+			memcg = mem_cgroup_iter(NULL, memcg, NULL);
+			if (memcg) {
+				lru_gen_proactive_next_id = mem_cgroup_id(memcg);
+				mem_cgroup_iter_break(NULL, memcg);
+			}
+			break;
+		}
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+done:
+	clear_mm_walk();
+	blk_finish_plug(&plug);
+	memalloc_noreclaim_restore(flags);
+	set_task_reclaim_state(current, NULL);
+
+	queue_delayed_work(system_unbound_wq, &lru_gen_proactive_work,
+			   msecs_to_jiffies(interval));
+}
+
 /******************************************************************************
  *                          sysfs interface
  ******************************************************************************/
@@ -5886,6 +6264,92 @@ static ssize_t min_ttl_ms_store(struct kobject *kobj, struct kobj_attribute *att
 
 static struct kobj_attribute lru_gen_min_ttl_attr = __ATTR_RW(min_ttl_ms);
 
+static ssize_t proactive_age_ms_show(struct kobject *kobj, struct kobj_attribute *attr,
+				     char *buf)
+{
+	return sysfs_emit(buf, "%u\n", jiffies_to_msecs(READ_ONCE(lru_gen_proactive_age)));
+}
+
+static ssize_t proactive_age_ms_store(struct kobject *kobj, struct kobj_attribute *attr,
+				      const char *buf, size_t len)
+{
+	unsigned int msecs;
+
+	if (kstrtouint(buf, 0, &msecs))
+		return -EINVAL;
+
+	WRITE_ONCE(lru_gen_proactive_age, msecs_to_jiffies(msecs));
+	if (msecs)
+		mod_delayed_work(system_unbound_wq, &lru_gen_proactive_work, 0);
+
+	return len;
+}
+
+static struct kobj_attribute lru_gen_proactive_age_attr = __ATTR_RW(proactive_age_ms);
+
+static ssize_t proactive_interval_ms_show(struct kobject *kobj, struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(lru_gen_proactive_interval));
+}
+
+static ssize_t proactive_interval_ms_store(struct kobject *kobj, struct kobj_attribute *attr,
+					   const char *buf, size_t len)
+{
+	unsigned int msecs;
+
+	if (kstrtouint(buf, 0, &msecs) || !msecs)
+		return -EINVAL;
+
+	WRITE_ONCE(lru_gen_proactive_interval, msecs);
+
+	return len;
+}
+
+static struct kobj_attribute lru_gen_proactive_interval_attr = __ATTR_RW(proactive_interval_ms);
+
+static ssize_t proactive_cpu_pct_show(struct kobject *kobj, struct kobj_attribute *attr,
+				      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(lru_gen_proactive_cpu));
+}
+
+static ssize_t proactive_cpu_pct_store(struct kobject *kobj, struct kobj_attribute *attr,
+				       const char *buf, size_t len)
+{
+	unsigned int pct;
+
+	if (kstrtouint(buf, 0, &pct) || !pct || pct > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(lru_gen_proactive_cpu, pct);
+
+	return len;
+}
+
+static struct kobj_attribute lru_gen_proactive_cpu_attr = __ATTR_RW(proactive_cpu_pct);
+
+static ssize_t proactive_refault_pct_show(struct kobject *kobj, struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(lru_gen_proactive_refault));
+}
+
+static ssize_t proactive_refault_pct_store(struct kobject *kobj, struct kobj_attribute *attr,
+					   const char *buf, size_t len)
+{
+	unsigned int pct;
+
+	if (kstrtouint(buf, 0, &pct) || pct > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(lru_gen_proactive_refault, pct);
+
+	return len;
+}
+
+static struct kobj_attribute lru_gen_proactive_refault_attr = __ATTR_RW(proactive_refault_pct);
+
 static ssize_t enabled_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
 	unsigned int caps = 0;
@@ -5919,9 +6383,12 @@ static ssize_t enabled_store(struct kobject *kobj, struct kobj_attribute *attr,
 	for (i = 0; i < NR_LRU_GEN_CAPS; i++) {
 		bool enabled = caps & BIT(i);
 
-		if (i == LRU_GEN_CORE)
+		if (i == LRU_GEN_CORE) {
 			lru_gen_change_state(enabled);
-		else if (enabled)
+			/* the proactive reclaim stops while the multi-gen LRU is off */
+			if (enabled && READ_ONCE(lru_gen_proactive_age))
+				mod_delayed_work(system_unbound_wq, &lru_gen_proactive_work, 0);
+		} else if (enabled)
 			static_branch_enable(&lru_gen_caps[i]);
 		else
 			static_branch_disable(&lru_gen_caps[i]);
@@ -5935,6 +6402,10 @@ static struct kobj_attribute lru_gen_enabled_attr = __ATTR_RW(enabled);
 static struct attribute *lru_gen_attrs[] = {
 	&lru_gen_min_ttl_attr.attr,
 	&lru_gen_enabled_attr.attr,
+	&lru_gen_proactive_age_attr.attr,
+	&lru_gen_proactive_interval_attr.attr,
+	&lru_gen_proactive_cpu_attr.attr,
+	&lru_gen_proactive_refault_attr.attr,
 	NULL
 };
 
@@ -6346,6 +6817,8 @@ void lru_gen_exit_memcg(struct mem_cgroup *memcg)
 {
 	int i;
 	int nid;
+	unsigned long key;
+	struct lru_gen_proactive *state;
 
 	VM_WARN_ON_ONCE(!list_empty(&memcg->mm_list.fifo));
 
@@ -6361,6 +6834,18 @@ void lru_gen_exit_memcg(struct mem_cgroup *memcg)
 			bitmap_free(lruvec->mm_state.filters[i]);
 			lruvec->mm_state.filters[i] = NULL;
 		}
+
+		/* the entry might already belong to a new memcg with the same id */
+		key = lru_gen_proactive_key(memcg, nid);
+		xa_lock(&lru_gen_proactive_xa);
+		state = xa_load(&lru_gen_proactive_xa, key);
+		if (state && state->memcg == memcg)
+			__xa_erase(&lru_gen_proactive_xa, key);
+		else
+			state = NULL;
+		xa_unlock(&lru_gen_proactive_xa);
+
+		kfree(state);
 	}
 }
 
@@ -1409,7 +1409,22 @@ const char * const vmstat_text[] = {
 	"vma_lock_abort",
 	"vma_lock_retry",
 	"vma_lock_miss",
+	"vma_lock_fallback_access",
+	"vma_lock_fallback_anon",
+	"vma_lock_fallback_fault",
+	"vma_lock_fallback_device",
+	"vma_lock_io_retry",
 #endif
+#ifdef CONFIG_SWAP
+	"swap_ra_inmem_skip",
+#endif
+#ifdef CONFIG_LRU_GEN
+	"lru_gen_proactive_reclaim",
+	"lru_gen_proactive_refault",
+	"lru_gen_proactive_backoff",
+#endif
+	"ra_replay",
+	"ra_replay_pages",
 #endif /* CONFIG_VM_EVENT_COUNTERS || CONFIG_MEMCG */
 };
 #endif /* CONFIG_PROC_FS || CONFIG_SYSFS || CONFIG_NUMA || CONFIG_MEMCG */
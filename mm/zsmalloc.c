@@ -33,7 +33,8 @@
 /*
  * lock ordering:
  *	page_lock
- *	pool->lock
+ *	pool->migrate_lock
+ *	class->lock
  *	zspage->lock
  */
 
@@ -62,6 +63,7 @@
 #include <linux/pagemap.h>
 #include <linux/fs.h>
 #include <linux/local_lock.h>
+#include <linux/workqueue.h>
 
 #define ZSPAGE_MAGIC	0x58
 
@@ -182,7 +184,31 @@ static struct dentry *zs_stat_root;
 
 static size_t huge_class_size;
 
+/* Background compaction, kicked from zs_free() on fragmented classes */
+static struct workqueue_struct *zs_compact_wq;
+
+static bool zs_bg_compact_enabled;
+module_param_named(bg_compact, zs_bg_compact_enabled, bool, 0644);
+
+/* Freeable pages in a size class that trigger background compaction */
+static unsigned int zs_bg_compact_threshold = 16;
+module_param_named(bg_compact_threshold, zs_bg_compact_threshold, uint, 0644);
+
+/* Max number of source zspages migrated by one background pass */
+static unsigned int zs_bg_compact_batch = 32;
+module_param_named(bg_compact_batch, zs_bg_compact_batch, uint, 0644);
+
+/* Delay between background passes */
+static unsigned int zs_bg_compact_interval_ms = 500;
+module_param_named(bg_compact_interval_ms, zs_bg_compact_interval_ms, uint,
+		   0644);
+
+/* Pool alloc/free rate (ops per second) above which a pass is deferred */
+static unsigned int zs_bg_compact_hot_rate = 200000;
+module_param_named(bg_compact_hot_rate, zs_bg_compact_hot_rate, uint, 0644);
+
 struct size_class {
+	spinlock_t lock;
 	struct list_head fullness_list[NR_FULLNESS_GROUPS];
 	/*
 	 * Size of objects stored in this class. Must be multiple
@@ -195,6 +221,8 @@ struct size_class {
 
 	unsigned int index;
 	struct zs_size_stat stats;
+	/* Number of zs_malloc/zs_free calls, used to detect a hot pool */
+	unsigned long nr_ops;
 };
 
 /*
@@ -217,6 +245,17 @@ struct link_free {
 	};
 };
 
+struct zs_compact_stats {
+	/* Background passes that ran / were deferred on a hot pool */
+	unsigned long bg_passes;
+	unsigned long bg_deferred;
+	/* Pages freed by background passes */
+	unsigned long bg_pages_freed;
+	/* Longest and cumulative time compaction held the pool locks */
+	u64 max_stall_ns;
+	u64 total_stall_ns;
+};
+
 struct zs_pool {
 	const char *name;
 
@@ -237,8 +276,17 @@ struct zs_pool {
 #ifdef CONFIG_COMPACTION
 	struct work_struct free_work;
 #endif
-	spinlock_t lock;
+	/* protect page/zspage migration */
+	rwlock_t migrate_lock;
 	atomic_t compaction_in_progress;
+
+	struct delayed_work bg_compact_work;
+	/* Class the next background pass starts from */
+	unsigned int bg_compact_next_class;
+	unsigned long bg_compact_last_ops;
+	unsigned long bg_compact_last_jiffies;
+	/* Updated under compaction_in_progress */
+	struct zs_compact_stats compact_stats;
 };
 
 struct zspage {
@@ -295,6 +343,10 @@ static void init_deferred_free(struct zs_pool *pool) {}
 static void SetZsPageMovable(struct zs_pool *pool, struct zspage *zspage) {}
 #endif
 
+static unsigned long zs_can_compact(struct size_class *class);
+static bool zs_bg_compact_needed(struct size_class *class);
+static void zs_bg_compact_kick(struct zs_pool *pool);
+
 static int create_cache(struct zs_pool *pool)
 {
 	pool->handle_cachep = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
@@ -341,7 +393,7 @@ static void cache_free_zspage(struct zs_pool *pool, struct zspage *zspage)
 	kmem_cache_free(pool->zspage_cachep, zspage);
 }
 
-/* pool->lock(which owns the handle) synchronizes races */
+/* class->lock(which owns the handle) synchronizes races */
 static void record_obj(unsigned long handle, unsigned long obj)
 {
 	*(unsigned long *)handle = obj;
@@ -436,7 +488,7 @@ static __maybe_unused int is_first_page(struct page *page)
 	return PagePrivate(page);
 }
 
-/* Protected by pool->lock */
+/* Protected by class->lock */
 static inline int get_zspage_inuse(struct zspage *zspage)
 {
 	return zspage->inuse;
@@ -552,8 +604,6 @@ static void __exit zs_stat_exit(void)
 	debugfs_remove_recursive(zs_stat_root);
 }
 
-static unsigned long zs_can_compact(struct size_class *class);
-
 static int zs_stats_size_show(struct seq_file *s, void *v)
 {
 	int i, fg;
@@ -578,7 +628,7 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 		if (class->index != i)
 			continue;
 
-		spin_lock(&pool->lock);
+		spin_lock(&class->lock);
 
 		seq_printf(s, " %5u %5u ", i, class->size);
 		for (fg = ZS_INUSE_RATIO_10; fg < NR_FULLNESS_GROUPS; fg++) {
@@ -589,7 +639,7 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 		obj_allocated = zs_stat_get(class, ZS_OBJS_ALLOCATED);
 		obj_used = zs_stat_get(class, ZS_OBJS_INUSE);
 		freeable = zs_can_compact(class);
-		spin_unlock(&pool->lock);
+		spin_unlock(&class->lock);
 
 		objs_per_zspage = class->objs_per_zspage;
 		pages_used = obj_allocated / objs_per_zspage *
@@ -619,6 +669,37 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(zs_stats_size);
 
+static int zs_stats_compact_show(struct seq_file *s, void *v)
+{
+	struct zs_pool *pool = s->private;
+	struct zs_compact_stats *stats = &pool->compact_stats;
+	unsigned long freeable = 0;
+	struct size_class *class;
+	int i;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = pool->size_class[i];
+		if (class->index != i)
+			continue;
+
+		spin_lock(&class->lock);
+		freeable += zs_can_compact(class);
+		spin_unlock(&class->lock);
+	}
+
+	seq_printf(s, "freeable_pages %lu\n", freeable);
+	seq_printf(s, "pages_compacted %lu\n",
+		   atomic_long_read(&pool->stats.pages_compacted));
+	seq_printf(s, "bg_passes %lu\n", READ_ONCE(stats->bg_passes));
+	seq_printf(s, "bg_deferred %lu\n", READ_ONCE(stats->bg_deferred));
+	seq_printf(s, "bg_pages_freed %lu\n", READ_ONCE(stats->bg_pages_freed));
+	seq_printf(s, "max_stall_ns %llu\n", READ_ONCE(stats->max_stall_ns));
+	seq_printf(s, "total_stall_ns %llu\n", READ_ONCE(stats->total_stall_ns));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(zs_stats_compact);
+
 static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 {
 	if (!zs_stat_root) {
@@ -630,6 +711,8 @@ static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 
 	debugfs_create_file("classes", S_IFREG | 0444, pool->stat_dentry, pool,
 			    &zs_stats_size_fops);
+	debugfs_create_file("compact", S_IFREG | 0444, pool->stat_dentry, pool,
+			    &zs_stats_compact_fops);
 }
 
 static void zs_pool_stat_destroy(struct zs_pool *pool)
@@ -854,7 +937,7 @@ static void __free_zspage(struct zs_pool *pool, struct size_class *class,
 
 	get_zspage_mapping(zspage, &class_idx, &fg);
 
-	assert_spin_locked(&pool->lock);
+	assert_spin_locked(&class->lock);
 
 	VM_BUG_ON(get_zspage_inuse(zspage));
 	VM_BUG_ON(fg != ZS_INUSE_RATIO_0);
@@ -1210,19 +1293,19 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	BUG_ON(in_interrupt());
 
 	/* It guarantees it can get zspage from handle safely */
-	spin_lock(&pool->lock);
+	read_lock(&pool->migrate_lock);
 	obj = handle_to_obj(handle);
 	obj_to_location(obj, &page, &obj_idx);
 	zspage = get_zspage(page);
 
 	/*
-	 * migration cannot move any zpages in this zspage. Here, pool->lock
-	 * is too heavy since callers would take some time until they calls
-	 * zs_unmap_object API so delegate the locking from class to zspage
-	 * which is smaller granularity.
+	 * migration cannot move any zpages in this zspage. Here, pool's
+	 * migrate_lock is too heavy since callers would take some time until
+	 * they calls zs_unmap_object API so delegate the locking from pool
+	 * to zspage which is smaller granularity.
 	 */
 	migrate_read_lock(zspage);
-	spin_unlock(&pool->lock);
+	read_unlock(&pool->migrate_lock);
 
 	class = zspage_class(pool, zspage);
 	off = offset_in_page(class->size * obj_idx);
@@ -1375,8 +1458,8 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 	size += ZS_HANDLE_SIZE;
 	class = pool->size_class[get_size_class_index(size)];
 
-	/* pool->lock effectively protects the zpage migration */
-	spin_lock(&pool->lock);
+	/* class->lock effectively protects the zpage migration */
+	spin_lock(&class->lock);
 	zspage = find_get_zspage(class);
 	if (likely(zspage)) {
 		obj = obj_malloc(pool, zspage, handle);
@@ -1388,7 +1471,7 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 		goto out;
 	}
 
-	spin_unlock(&pool->lock);
+	spin_unlock(&class->lock);
 
 	zspage = alloc_zspage(pool, class, gfp);
 	if (!zspage) {
@@ -1396,7 +1479,7 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 		return (unsigned long)ERR_PTR(-ENOMEM);
 	}
 
-	spin_lock(&pool->lock);
+	spin_lock(&class->lock);
 	obj = obj_malloc(pool, zspage, handle);
 	newfg = get_fullness_group(class, zspage);
 	insert_zspage(class, zspage, newfg);
@@ -1409,7 +1492,8 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 	/* We completely set up zspage so mark them as movable */
 	SetZsPageMovable(pool, zspage);
 out:
-	spin_unlock(&pool->lock);
+	class->nr_ops++;
+	spin_unlock(&class->lock);
 
 	return handle;
 }
@@ -1449,29 +1533,37 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	unsigned long obj;
 	struct size_class *class;
 	int fullness;
+	bool kick;
 
 	if (IS_ERR_OR_NULL((void *)handle))
 		return;
 
 	/*
-	 * The pool->lock protects the race with zpage's migration
+	 * The pool->migrate_lock protects the race with zpage's migration
 	 * so it's safe to get the page from handle.
 	 */
-	spin_lock(&pool->lock);
+	read_lock(&pool->migrate_lock);
 	obj = handle_to_obj(handle);
 	obj_to_page(obj, &f_page);
 	zspage = get_zspage(f_page);
 	class = zspage_class(pool, zspage);
+	spin_lock(&class->lock);
+	read_unlock(&pool->migrate_lock);
 
 	class_stat_dec(class, ZS_OBJS_INUSE, 1);
 	obj_free(class->size, obj);
+	class->nr_ops++;
 
 	fullness = fix_fullness_group(class, zspage);
 	if (fullness == ZS_INUSE_RATIO_0)
 		free_zspage(pool, class, zspage);
 
-	spin_unlock(&pool->lock);
+	kick = zs_bg_compact_needed(class);
+	spin_unlock(&class->lock);
 	cache_free_handle(pool, handle);
+
+	if (kick)
+		zs_bg_compact_kick(pool);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
@@ -1778,6 +1870,7 @@ static void replace_sub_page(struct size_class *class, struct zspage *zspage,
 static bool zs_page_isolate(struct page *page, isolate_mode_t mode)
 {
 	struct zs_pool *pool;
+	struct size_class *class;
 	struct zspage *zspage;
 
 	/*
@@ -1788,9 +1881,10 @@ static bool zs_page_isolate(struct page *page, isolate_mode_t mode)
 
 	zspage = get_zspage(page);
 	pool = zspage->pool;
-	spin_lock(&pool->lock);
+	class = zspage_class(pool, zspage);
+	spin_lock(&class->lock);
 	inc_zspage_isolation(zspage);
-	spin_unlock(&pool->lock);
+	spin_unlock(&class->lock);
 
 	return true;
 }
@@ -1823,12 +1917,17 @@ static int zs_page_migrate(struct page *newpage, struct page *page,
 	pool = zspage->pool;
 
 	/*
-	 * The pool's lock protects the race between zpage migration
+	 * The pool migrate_lock protects the race between zpage migration
 	 * and zs_free.
 	 */
-	spin_lock(&pool->lock);
+	write_lock(&pool->migrate_lock);
 	class = zspage_class(pool, zspage);
 
+	/*
+	 * the class lock protects zpage alloc/free in the zspage.
+	 */
+	spin_lock(&class->lock);
+
 	/* the migrate_write_lock protects zpage access via zs_map_object */
 	migrate_write_lock(zspage);
 
@@ -1859,9 +1958,10 @@ static int zs_page_migrate(struct page *newpage, struct page *page,
 	dec_zspage_isolation(zspage);
 	/*
 	 * Since we complete the data copy and set up new zspage structure,
-	 * it's okay to release the pool's lock.
+	 * it's okay to release migration_lock.
 	 */
-	spin_unlock(&pool->lock);
+	write_unlock(&pool->migrate_lock);
+	spin_unlock(&class->lock);
 	migrate_write_unlock(zspage);
 
 	get_page(newpage);
@@ -1879,15 +1979,17 @@ static int zs_page_migrate(struct page *newpage, struct page *page,
 static void zs_page_putback(struct page *page)
 {
 	struct zs_pool *pool;
+	struct size_class *class;
 	struct zspage *zspage;
 
 	VM_BUG_ON_PAGE(!PageIsolated(page), page);
 
 	zspage = get_zspage(page);
 	pool = zspage->pool;
-	spin_lock(&pool->lock);
+	class = zspage_class(pool, zspage);
+	spin_lock(&class->lock);
 	dec_zspage_isolation(zspage);
-	spin_unlock(&pool->lock);
+	spin_unlock(&class->lock);
 }
 
 static const struct movable_operations zsmalloc_mops = {
@@ -1916,10 +2018,10 @@ static void async_free_zspage(struct work_struct *work)
 		if (class->index != i)
 			continue;
 
-		spin_lock(&pool->lock);
+		spin_lock(&class->lock);
 		list_splice_init(&class->fullness_list[ZS_INUSE_RATIO_0],
 				 &free_pages);
-		spin_unlock(&pool->lock);
+		spin_unlock(&class->lock);
 	}
 
 	list_for_each_entry_safe(zspage, tmp, &free_pages, list) {
@@ -1929,9 +2031,9 @@ static void async_free_zspage(struct work_struct *work)
 		get_zspage_mapping(zspage, &class_idx, &fullness);
 		VM_BUG_ON(fullness != ZS_INUSE_RATIO_0);
 		class = pool->size_class[class_idx];
-		spin_lock(&pool->lock);
+		spin_lock(&class->lock);
 		__free_zspage(pool, class, zspage);
-		spin_unlock(&pool->lock);
+		spin_unlock(&class->lock);
 	}
 };
 
@@ -1984,8 +2086,52 @@ static unsigned long zs_can_compact(struct size_class *class)
 	return obj_wasted * class->pages_per_zspage;
 }
 
+/*
+ * A compaction run: how many source zspages it may still migrate and
+ * how long it kept the pool locked.
+ */
+struct zs_compact_control {
+	unsigned long nr_to_migrate;
+	u64 lock_start;
+	u64 max_stall_ns;
+	u64 total_stall_ns;
+};
+
+static void zs_compact_lock(struct zs_pool *pool, struct size_class *class,
+			    struct zs_compact_control *cc)
+{
+	write_lock(&pool->migrate_lock);
+	spin_lock(&class->lock);
+	cc->lock_start = ktime_get_ns();
+}
+
+static void zs_compact_unlock(struct zs_pool *pool, struct size_class *class,
+			      struct zs_compact_control *cc)
+{
+	u64 held = ktime_get_ns() - cc->lock_start;
+
+	spin_unlock(&class->lock);
+	write_unlock(&pool->migrate_lock);
+
+	cc->max_stall_ns = max(cc->max_stall_ns, held);
+	cc->total_stall_ns += held;
+}
+
+/* Caller must own pool->compaction_in_progress */
+static void zs_compact_account(struct zs_pool *pool,
+			       struct zs_compact_control *cc)
+{
+	struct zs_compact_stats *stats = &pool->compact_stats;
+
+	if (cc->max_stall_ns > stats->max_stall_ns)
+		WRITE_ONCE(stats->max_stall_ns, cc->max_stall_ns);
+	WRITE_ONCE(stats->total_stall_ns,
+		   stats->total_stall_ns + cc->total_stall_ns);
+}
+
 static unsigned long __zs_compact(struct zs_pool *pool,
-				  struct size_class *class)
+				  struct size_class *class,
+				  struct zs_compact_control *cc)
 {
 	struct zspage *src_zspage = NULL;
 	struct zspage *dst_zspage = NULL;
@@ -1995,8 +2141,8 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 	 * protect the race between zpage migration and zs_free
 	 * as well as zpage allocation/free
 	 */
-	spin_lock(&pool->lock);
-	while (zs_can_compact(class)) {
+	zs_compact_lock(pool, class, cc);
+	while (cc->nr_to_migrate && zs_can_compact(class)) {
 		int fg;
 
 		if (!dst_zspage) {
@@ -2013,6 +2159,7 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 		migrate_write_lock_nested(src_zspage);
 
 		migrate_zspage(pool, src_zspage, dst_zspage);
+		cc->nr_to_migrate--;
 		fg = putback_zspage(class, src_zspage);
 		migrate_write_unlock(src_zspage);
 
@@ -2023,14 +2170,15 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 		src_zspage = NULL;
 
 		if (get_fullness_group(class, dst_zspage) == ZS_INUSE_RATIO_100
-		    || spin_is_contended(&pool->lock)) {
+		    || spin_is_contended(&class->lock)
+		    || rwlock_is_contended(&pool->migrate_lock)) {
 			putback_zspage(class, dst_zspage);
 			migrate_write_unlock(dst_zspage);
 			dst_zspage = NULL;
 
-			spin_unlock(&pool->lock);
+			zs_compact_unlock(pool, class, cc);
 			cond_resched();
-			spin_lock(&pool->lock);
+			zs_compact_lock(pool, class, cc);
 		}
 	}
 
@@ -2043,7 +2191,7 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 		putback_zspage(class, dst_zspage);
 		migrate_write_unlock(dst_zspage);
 	}
-	spin_unlock(&pool->lock);
+	zs_compact_unlock(pool, class, cc);
 
 	return pages_freed;
 }
@@ -2053,12 +2201,13 @@ unsigned long zs_compact(struct zs_pool *pool)
 	int i;
 	struct size_class *class;
 	unsigned long pages_freed = 0;
+	struct zs_compact_control cc = { .nr_to_migrate = ULONG_MAX };
 
 	/*
-	 * Pool compaction is performed under pool->lock so it is basically
-	 * single-threaded. Having more than one thread in __zs_compact()
-	 * will increase pool->lock contention, which will impact other
-	 * zsmalloc operations that need pool->lock.
+	 * Pool compaction is performed under pool->migrate_lock so it is
+	 * basically single-threaded. Having more than one thread in
+	 * __zs_compact() will increase pool->migrate_lock contention, which
+	 * will impact other zsmalloc operations that need pool->migrate_lock.
 	 */
 	if (atomic_xchg(&pool->compaction_in_progress, 1))
 		return 0;
@@ -2067,15 +2216,126 @@ unsigned long zs_compact(struct zs_pool *pool)
 		class = pool->size_class[i];
 		if (class->index != i)
 			continue;
-		pages_freed += __zs_compact(pool, class);
+		pages_freed += __zs_compact(pool, class, &cc);
 	}
 	atomic_long_add(pages_freed, &pool->stats.pages_compacted);
+	zs_compact_account(pool, &cc);
 	atomic_set(&pool->compaction_in_progress, 0);
 
 	return pages_freed;
 }
 EXPORT_SYMBOL_GPL(zs_compact);
 
+/* Caller should hold class->lock */
+static bool zs_bg_compact_needed(struct size_class *class)
+{
+	return READ_ONCE(zs_bg_compact_enabled) &&
+		zs_can_compact(class) >= READ_ONCE(zs_bg_compact_threshold);
+}
+
+static void zs_bg_compact_queue(struct zs_pool *pool)
+{
+	queue_delayed_work(zs_compact_wq, &pool->bg_compact_work,
+			   msecs_to_jiffies(READ_ONCE(zs_bg_compact_interval_ms)));
+}
+
+static void zs_bg_compact_kick(struct zs_pool *pool)
+{
+	/* Avoid bouncing the work's pending bit on every zs_free() */
+	if (!zs_compact_wq || delayed_work_pending(&pool->bg_compact_work))
+		return;
+
+	zs_bg_compact_queue(pool);
+}
+
+/*
+ * The pool is hot when zs_malloc/zs_free ran faster than
+ * bg_compact_hot_rate since the previous background pass. Compacting
+ * then would only add contention on the class locks.
+ */
+static bool zs_bg_compact_pool_hot(struct zs_pool *pool)
+{
+	unsigned long ops = 0, delta, elapsed;
+	int i;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = pool->size_class[i];
+
+		if (class->index != i)
+			continue;
+		ops += READ_ONCE(class->nr_ops);
+	}
+
+	delta = ops - pool->bg_compact_last_ops;
+	elapsed = max(jiffies - pool->bg_compact_last_jiffies, 1UL);
+	pool->bg_compact_last_ops = ops;
+	pool->bg_compact_last_jiffies = jiffies;
+
+	return (u64)delta * HZ > (u64)READ_ONCE(zs_bg_compact_hot_rate) * elapsed;
+}
+
+static void zs_bg_compact_work(struct work_struct *work)
+{
+	struct zs_pool *pool = container_of(to_delayed_work(work),
+					    struct zs_pool, bg_compact_work);
+	struct zs_compact_stats *stats = &pool->compact_stats;
+	struct zs_compact_control cc = {
+		.nr_to_migrate = max(READ_ONCE(zs_bg_compact_batch), 1U),
+	};
+	unsigned long pages_freed = 0;
+	struct size_class *class;
+	bool fragmented = false;
+	int i, idx;
+
+	if (zs_bg_compact_pool_hot(pool)) {
+		WRITE_ONCE(stats->bg_deferred, stats->bg_deferred + 1);
+		goto requeue;
+	}
+
+	/* Leave the pool to an explicit zs_compact() running right now */
+	if (atomic_xchg(&pool->compaction_in_progress, 1))
+		goto requeue;
+
+	/*
+	 * Resume the walk where the previous pass ran out of budget, so
+	 * that small classes are not starved by the big ones.
+	 */
+	idx = pool->bg_compact_next_class;
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = pool->size_class[idx];
+		if (class->index == idx && zs_can_compact(class)) {
+			if (!cc.nr_to_migrate)
+				break;
+			pages_freed += __zs_compact(pool, class, &cc);
+		}
+		idx = idx ? idx - 1 : ZS_SIZE_CLASSES - 1;
+	}
+	pool->bg_compact_next_class = idx;
+
+	atomic_long_add(pages_freed, &pool->stats.pages_compacted);
+	WRITE_ONCE(stats->bg_passes, stats->bg_passes + 1);
+	WRITE_ONCE(stats->bg_pages_freed, stats->bg_pages_freed + pages_freed);
+	zs_compact_account(pool, &cc);
+	atomic_set(&pool->compaction_in_progress, 0);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = pool->size_class[i];
+		if (class->index != i)
+			continue;
+
+		spin_lock(&class->lock);
+		fragmented = zs_bg_compact_needed(class);
+		spin_unlock(&class->lock);
+		if (fragmented)
+			break;
+	}
+	if (!fragmented)
+		return;
+requeue:
+	if (READ_ONCE(zs_bg_compact_enabled))
+		zs_bg_compact_queue(pool);
+}
+
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
 {
 	memcpy(stats, &pool->stats, sizeof(struct zs_pool_stats));
@@ -2177,7 +2437,10 @@ struct zs_pool *zs_create_pool(const char *name)
 		return NULL;
 
 	init_deferred_free(pool);
-	spin_lock_init(&pool->lock);
+	INIT_DELAYED_WORK(&pool->bg_compact_work, zs_bg_compact_work);
+	pool->bg_compact_next_class = ZS_SIZE_CLASSES - 1;
+	pool->bg_compact_last_jiffies = jiffies;
+	rwlock_init(&pool->migrate_lock);
 	atomic_set(&pool->compaction_in_progress, 0);
 
 	pool->name = kstrdup(name, GFP_KERNEL);
@@ -2245,6 +2508,7 @@ struct zs_pool *zs_create_pool(const char *name)
 		if (!class)
 			goto err;
 
+		spin_lock_init(&class->lock);
 		class->size = size;
 		class->index = i;
 		class->pages_per_zspage = pages_per_zspage;
@@ -2284,6 +2548,7 @@ void zs_destroy_pool(struct zs_pool *pool)
 	int i;
 
 	zs_unregister_shrinker(pool);
+	cancel_delayed_work_sync(&pool->bg_compact_work);
 	zs_flush_migration(pool);
 	zs_pool_stat_destroy(pool);
 
@@ -2322,6 +2587,15 @@ static int __init zs_init(void)
 	if (ret)
 		goto out;
 
+	/*
+	 * Background compaction is an optimization only, so keep going
+	 * without it. WQ_SYSFS lets userspace lower the workers' priority.
+	 */
+	zs_compact_wq = alloc_workqueue("zs_compact",
+					WQ_UNBOUND | WQ_FREEZABLE | WQ_SYSFS, 0);
+	if (!zs_compact_wq)
+		pr_warn("failed to create background compaction workqueue\n");
+
 #ifdef CONFIG_ZPOOL
 	zpool_register_driver(&zs_zpool_driver);
 #endif
@@ -2340,6 +2614,8 @@ static void __exit zs_exit(void)
 	zpool_unregister_driver(&zs_zpool_driver);
 #endif
 	cpuhp_remove_state(CPUHP_MM_ZS_PREPARE);
+	if (zs_compact_wq)
+		destroy_workqueue(zs_compact_wq);
 
 	zs_stat_exit();
 }
@@ -69,6 +69,9 @@ static u64 zswap_reject_alloc_fail;
 static u64 zswap_reject_kmemcache_fail;
 /* Duplicate store was encountered (rare) */
 static u64 zswap_duplicate_entry;
+/* Multi-folio zswap_store_batch() calls and the pages they stored */
+static u64 zswap_store_batches;
+static u64 zswap_store_batched_pages;
 
 /* Shrinker work queue */
 static struct workqueue_struct *shrink_wq;
@@ -141,6 +144,10 @@ static bool zswap_exclusive_loads_enabled = IS_ENABLED(
 		CONFIG_ZSWAP_EXCLUSIVE_LOADS_DEFAULT_ON);
 module_param_named(exclusive_loads, zswap_exclusive_loads_enabled, bool, 0644);
 
+/* Enable/disable batching of stores from reclaim (enabled by default) */
+static bool zswap_batch_store_enabled = true;
+module_param_named(batch_store, zswap_batch_store_enabled, bool, 0644);
+
 /* Number of zpools in zswap_pool (empirically determined for scalability) */
 #define ZSWAP_NR_ZPOOLS 32
 
@@ -216,10 +223,14 @@ struct zswap_entry {
  * The tree lock in the zswap_tree struct protects a few things:
  * - the rbtree
  * - the refcount field of each entry in the tree
+ *
+ * The stored bitmap mirrors which offsets are in the rbtree. It is updated
+ * under the tree lock but read locklessly by zswap_stored().
  */
 struct zswap_tree {
 	struct rb_root rbroot;
 	spinlock_t lock;
+	unsigned long *stored;
 };
 
 static struct zswap_tree *zswap_trees[MAX_SWAPFILES];
@@ -625,8 +636,11 @@ static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 static void zswap_invalidate_entry(struct zswap_tree *tree,
 				   struct zswap_entry *entry)
 {
-	if (zswap_rb_erase(&tree->rbroot, entry))
+	if (zswap_rb_erase(&tree->rbroot, entry)) {
+		if (tree->stored)
+			clear_bit(swp_offset(entry->swpentry), tree->stored);
 		zswap_entry_put(tree, entry);
+	}
 }
 
 static int zswap_reclaim_entry(struct zswap_pool *pool)
@@ -1190,51 +1204,18 @@ static void zswap_fill_page(void *ptr, unsigned long value)
 	memset_l(page, value, PAGE_SIZE / sizeof(unsigned long));
 }
 
-bool zswap_store(struct folio *folio)
+/*
+ * Allocate an entry for @folio after the global and cgroup limit checks.
+ * Same-value filled folios come back ready to insert; all others get a pool
+ * reference and still have to be compressed with zswap_compress().
+ */
+static struct zswap_entry *zswap_store_prepare(struct folio *folio,
+					       bool *shrink)
 {
-	swp_entry_t swp = folio->swap;
-	int type = swp_type(swp);
-	pgoff_t offset = swp_offset(swp);
-	struct page *page = &folio->page;
-	struct zswap_tree *tree = zswap_trees[type];
-	struct zswap_entry *entry, *dupentry;
-	struct scatterlist input, output;
-	struct crypto_acomp_ctx *acomp_ctx;
 	struct obj_cgroup *objcg = NULL;
-	struct zswap_pool *pool;
-	struct zpool *zpool;
-	unsigned int dlen = PAGE_SIZE;
-	unsigned long handle, value;
-	char *buf;
-	u8 *src, *dst;
-	gfp_t gfp;
-	int ret;
-
-	VM_WARN_ON_ONCE(!folio_test_locked(folio));
-	VM_WARN_ON_ONCE(!folio_test_swapcache(folio));
-
-	/* Large folios aren't supported */
-	if (folio_test_large(folio))
-		return false;
-
-	if (!tree)
-		return false;
-
-	/*
-	 * If this is a duplicate, it must be removed before attempting to store
-	 * it, otherwise, if the store fails the old page won't be removed from
-	 * the tree, and it might be written back overriding the new data.
-	 */
-	spin_lock(&tree->lock);
-	dupentry = zswap_rb_search(&tree->rbroot, offset);
-	if (dupentry) {
-		zswap_duplicate_entry++;
-		zswap_invalidate_entry(tree, dupentry);
-	}
-	spin_unlock(&tree->lock);
-
-	if (!zswap_enabled)
-		return false;
+	struct zswap_entry *entry;
+	unsigned long value;
+	u8 *src;
 
 	/*
 	 * XXX: zswap reclaim does not work with cgroups yet. Without a
@@ -1249,13 +1230,15 @@ bool zswap_store(struct folio *folio)
 	if (zswap_is_full()) {
 		zswap_pool_limit_hit++;
 		zswap_pool_reached_full = true;
-		goto shrink;
+		*shrink = true;
+		goto reject;
 	}
 
 	if (zswap_pool_reached_full) {
-	       if (!zswap_can_accept())
-			goto shrink;
-		else
+	       if (!zswap_can_accept()) {
+			*shrink = true;
+			goto reject;
+		} else
 			zswap_pool_reached_full = false;
 	}
 
@@ -1265,16 +1248,18 @@ bool zswap_store(struct folio *folio)
 		zswap_reject_kmemcache_fail++;
 		goto reject;
 	}
+	entry->swpentry = folio->swap;
+	entry->objcg = objcg;
+	entry->pool = NULL;
 
 	if (zswap_same_filled_pages_enabled) {
-		src = kmap_atomic(page);
+		src = kmap_atomic(&folio->page);
 		if (zswap_is_page_same_filled(src, &value)) {
 			kunmap_atomic(src);
-			entry->swpentry = swp_entry(type, offset);
 			entry->length = 0;
 			entry->value = value;
 			atomic_inc(&zswap_same_filled_pages);
-			goto insert_entry;
+			return entry;
 		}
 		kunmap_atomic(src);
 	}
@@ -1287,14 +1272,42 @@ bool zswap_store(struct folio *folio)
 	if (!entry->pool)
 		goto freepage;
 
-	/* compress */
-	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
+	return entry;
 
-	mutex_lock(acomp_ctx->mutex);
+freepage:
+	zswap_entry_cache_free(entry);
+reject:
+	if (objcg)
+		obj_cgroup_put(objcg);
+	return NULL;
+}
+
+/* Drop an entry that was prepared but will not be inserted */
+static void zswap_store_abort(struct zswap_entry *entry)
+{
+	if (entry->pool)
+		zswap_pool_put(entry->pool);
+	if (entry->objcg)
+		obj_cgroup_put(entry->objcg);
+	zswap_entry_cache_free(entry);
+}
+
+/* Caller should hold acomp_ctx->mutex */
+static bool zswap_compress(struct folio *folio, struct zswap_entry *entry,
+			   struct crypto_acomp_ctx *acomp_ctx)
+{
+	struct scatterlist input, output;
+	unsigned int dlen = PAGE_SIZE;
+	unsigned long handle;
+	struct zpool *zpool;
+	char *buf;
+	u8 *dst;
+	gfp_t gfp;
+	int ret;
 
 	dst = acomp_ctx->dstmem;
 	sg_init_table(&input, 1);
-	sg_set_page(&input, page, PAGE_SIZE, 0);
+	sg_set_page(&input, &folio->page, PAGE_SIZE, 0);
 
 	/* zswap_dstmem is of size (PAGE_SIZE * 2). Reflect same in sg_list */
 	sg_init_one(&output, dst, PAGE_SIZE * 2);
@@ -1315,7 +1328,7 @@ bool zswap_store(struct folio *folio)
 	dlen = acomp_ctx->req->dlen;
 
 	if (ret)
-		goto put_dstmem;
+		return false;
 
 	/* store */
 	zpool = zswap_find_zpool(entry);
@@ -1325,72 +1338,213 @@ bool zswap_store(struct folio *folio)
 	ret = zpool_malloc(zpool, dlen, gfp, &handle);
 	if (ret == -ENOSPC) {
 		zswap_reject_compress_poor++;
-		goto put_dstmem;
+		return false;
 	}
 	if (ret) {
 		zswap_reject_alloc_fail++;
-		goto put_dstmem;
+		return false;
 	}
 	buf = zpool_map_handle(zpool, handle, ZPOOL_MM_WO);
 	memcpy(buf, dst, dlen);
 	zpool_unmap_handle(zpool, handle);
-	mutex_unlock(acomp_ctx->mutex);
 
 	/* populate entry */
-	entry->swpentry = swp_entry(type, offset);
 	entry->handle = handle;
 	entry->length = dlen;
 
-insert_entry:
-	entry->objcg = objcg;
-	if (objcg) {
-		obj_cgroup_charge_zswap(objcg, entry->length);
-		/* Account before objcg ref is moved to tree */
-		count_objcg_event(objcg, ZSWPOUT);
-	}
+	return true;
+}
+
+/**
+ * zswap_store_batch - store a batch of swap cache folios in zswap
+ * @folios: locked swap cache folios, at most ZSWAP_STORE_BATCH_MAX
+ * @nr: number of folios in @folios
+ * @stored: bitmap of @nr bits, set for each folio that was stored
+ *
+ * Works like calling zswap_store() on every folio, but the per-CPU
+ * compression context is taken once for the whole batch and entries are
+ * looked up and inserted with one acquisition of the tree lock per run of
+ * folios sharing a swap device.
+ *
+ * Returns the number of folios stored.
+ */
+int zswap_store_batch(struct folio **folios, int nr, unsigned long *stored)
+{
+	struct zswap_entry *entries[ZSWAP_STORE_BATCH_MAX];
+	struct crypto_acomp_ctx *acomp_ctx = NULL;
+	struct zswap_entry *entry, *dupentry;
+	struct zswap_tree *tree = NULL;
+	struct zswap_pool *pool = NULL;
+	struct folio *folio;
+	bool shrink = false;
+	int i, nr_stored = 0;
+
+	if (WARN_ON_ONCE(nr > ZSWAP_STORE_BATCH_MAX))
+		nr = ZSWAP_STORE_BATCH_MAX;
+
+	bitmap_zero(stored, nr);
 
-	/* map */
-	spin_lock(&tree->lock);
 	/*
-	 * A duplicate entry should have been removed at the beginning of this
-	 * function. Since the swap entry should be pinned, if a duplicate is
-	 * found again here it means that something went wrong in the swap
-	 * cache.
+	 * If this is a duplicate, it must be removed before attempting to store
+	 * it, otherwise, if the store fails the old page won't be removed from
+	 * the tree, and it might be written back overriding the new data.
 	 */
-	while (zswap_rb_insert(&tree->rbroot, entry, &dupentry) == -EEXIST) {
-		WARN_ON(1);
-		zswap_duplicate_entry++;
-		zswap_invalidate_entry(tree, dupentry);
+	for (i = 0; i < nr; i++) {
+		struct zswap_tree *next;
+
+		folio = folios[i];
+		entries[i] = NULL;
+
+		VM_WARN_ON_ONCE(!folio_test_locked(folio));
+		VM_WARN_ON_ONCE(!folio_test_swapcache(folio));
+
+		/* Large folios aren't supported */
+		if (folio_test_large(folio))
+			continue;
+
+		next = zswap_trees[swp_type(folio->swap)];
+		if (!next)
+			continue;
+
+		if (next != tree) {
+			if (tree)
+				spin_unlock(&tree->lock);
+			tree = next;
+			spin_lock(&tree->lock);
+		}
+		dupentry = zswap_rb_search(&tree->rbroot, swp_offset(folio->swap));
+		if (dupentry) {
+			zswap_duplicate_entry++;
+			zswap_invalidate_entry(tree, dupentry);
+		}
+		/* Mark the folio as a candidate for the passes below */
+		__set_bit(i, stored);
 	}
-	if (entry->length) {
-		spin_lock(&entry->pool->lru_lock);
-		list_add(&entry->lru, &entry->pool->lru);
-		spin_unlock(&entry->pool->lru_lock);
+	if (tree)
+		spin_unlock(&tree->lock);
+
+	if (!zswap_enabled) {
+		bitmap_zero(stored, nr);
+		return 0;
 	}
-	spin_unlock(&tree->lock);
 
-	/* update stats */
-	atomic_inc(&zswap_stored_pages);
-	zswap_update_total_size();
-	count_vm_event(ZSWPOUT);
+	for_each_set_bit(i, stored, nr) {
+		entries[i] = zswap_store_prepare(folios[i], &shrink);
+		if (!entries[i])
+			__clear_bit(i, stored);
+	}
 
-	return true;
+	/* compress back-to-back, holding the compression context once */
+	for_each_set_bit(i, stored, nr) {
+		entry = entries[i];
+		if (!entry->pool)
+			continue;
 
-put_dstmem:
-	mutex_unlock(acomp_ctx->mutex);
-	zswap_pool_put(entry->pool);
-freepage:
-	zswap_entry_cache_free(entry);
-reject:
-	if (objcg)
-		obj_cgroup_put(objcg);
-	return false;
+		if (entry->pool != pool) {
+			if (acomp_ctx)
+				mutex_unlock(acomp_ctx->mutex);
+			pool = entry->pool;
+			acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
+			mutex_lock(acomp_ctx->mutex);
+		}
+
+		if (!zswap_compress(folios[i], entry, acomp_ctx)) {
+			zswap_store_abort(entry);
+			entries[i] = NULL;
+			__clear_bit(i, stored);
+		}
+	}
+	if (acomp_ctx)
+		mutex_unlock(acomp_ctx->mutex);
+
+	tree = NULL;
+	for_each_set_bit(i, stored, nr) {
+		struct zswap_tree *next;
+
+		entry = entries[i];
+		if (entry->objcg) {
+			obj_cgroup_charge_zswap(entry->objcg, entry->length);
+			/* Account before objcg ref is moved to tree */
+			count_objcg_event(entry->objcg, ZSWPOUT);
+		}
 
-shrink:
-	pool = zswap_pool_last_get();
-	if (pool && !queue_work(shrink_wq, &pool->shrink_work))
-		zswap_pool_put(pool);
-	goto reject;
+		/* map */
+		next = zswap_trees[swp_type(entry->swpentry)];
+		if (next != tree) {
+			if (tree)
+				spin_unlock(&tree->lock);
+			tree = next;
+			spin_lock(&tree->lock);
+		}
+		/*
+		 * A duplicate entry should have been removed at the beginning
+		 * of this function. Since the swap entry should be pinned, if
+		 * a duplicate is found again here it means that something went
+		 * wrong in the swap cache.
+		 */
+		while (zswap_rb_insert(&tree->rbroot, entry, &dupentry) == -EEXIST) {
+			WARN_ON(1);
+			zswap_duplicate_entry++;
+			zswap_invalidate_entry(tree, dupentry);
+		}
+		if (tree->stored)
+			set_bit(swp_offset(entry->swpentry), tree->stored);
+		if (entry->length) {
+			spin_lock(&entry->pool->lru_lock);
+			list_add(&entry->lru, &entry->pool->lru);
+			spin_unlock(&entry->pool->lru_lock);
+		}
+		nr_stored++;
+	}
+	if (tree)
+		spin_unlock(&tree->lock);
+
+	if (nr_stored) {
+		/* update stats */
+		atomic_add(nr_stored, &zswap_stored_pages);
+		zswap_update_total_size();
+		count_vm_events(ZSWPOUT, nr_stored);
+		if (nr > 1) {
+			zswap_store_batches++;
+			zswap_store_batched_pages += nr_stored;
+		}
+	}
+
+	if (shrink) {
+		pool = zswap_pool_last_get();
+		if (pool && !queue_work(shrink_wq, &pool->shrink_work))
+			zswap_pool_put(pool);
+	}
+
+	return nr_stored;
+}
+
+bool zswap_store(struct folio *folio)
+{
+	unsigned long stored;
+
+	return zswap_store_batch(&folio, 1, &stored) == 1;
+}
+
+/* Whether reclaim should hand swap cache folios to zswap_store_batch() */
+bool zswap_store_batch_enabled(void)
+{
+	return zswap_enabled && zswap_batch_store_enabled;
+}
+
+/*
+ * Whether the data of @swp is held by zswap rather than the swap device.
+ * Lockless, so only a hint: the entry may be stored or invalidated
+ * concurrently.
+ */
+bool zswap_stored(swp_entry_t swp)
+{
+	struct zswap_tree *tree = zswap_trees[swp_type(swp)];
+
+	if (!tree || !tree->stored)
+		return false;
+
+	return test_bit(swp_offset(swp), tree->stored);
 }
 
 bool zswap_load(struct folio *folio)
@@ -1509,6 +1663,12 @@ void zswap_swapon(int type)
 		return;
 	}
 
+	tree->stored = kvcalloc(BITS_TO_LONGS(swp_swap_info(swp_entry(type, 0))->max),
+				sizeof(unsigned long), GFP_KERNEL);
+	if (!tree->stored)
+		pr_warn("bitmap alloc failed, zswap_stored() disabled for swap type %d\n",
+			type);
+
 	tree->rbroot = RB_ROOT;
 	spin_lock_init(&tree->lock);
 	zswap_trees[type] = tree;
@@ -1528,6 +1688,7 @@ void zswap_swapoff(int type)
 		zswap_free_entry(entry);
 	tree->rbroot = RB_ROOT;
 	spin_unlock(&tree->lock);
+	kvfree(tree->stored);
 	kfree(tree);
 	zswap_trees[type] = NULL;
 }
@@ -1561,6 +1722,10 @@ static int zswap_debugfs_init(void)
 			   zswap_debugfs_root, &zswap_written_back_pages);
 	debugfs_create_u64("duplicate_entry", 0444,
 			   zswap_debugfs_root, &zswap_duplicate_entry);
+	debugfs_create_u64("store_batches", 0444,
+			   zswap_debugfs_root, &zswap_store_batches);
+	debugfs_create_u64("store_batched_pages", 0444,
+			   zswap_debugfs_root, &zswap_store_batched_pages);
 	debugfs_create_u64("pool_total_size", 0444,
 			   zswap_debugfs_root, &zswap_pool_total_size);
 	debugfs_create_atomic_t("stored_pages", 0444,